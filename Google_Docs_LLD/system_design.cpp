@@ -115,16 +115,91 @@ class NewTabElement: public Element{
 };
 
 
+// text or image element that only views its content inside a bulk imported source buffer,
+// so importing does not allocate a string per element
+class SpanElement: public Element{
+    private:
+        string_view content;
+        bool image = false;
+
+    public:
+        SpanElement() = default;
+        SpanElement(string_view content, bool image): content(content), image(image){}
+
+        string render() override{
+            return image ? "[ Image : " + string(content) + " ]" : string(content);
+        }
+};
+
+// everything a bulk import creates: the source buffer, the span elements viewing it and the shared
+// new line / tab elements. The document that received the elements owns the arena.
+class ElementArena{
+    private:
+        string source;
+        vector<SpanElement> spans;  // one per text / image token, sized once before filling, so pointers into it stay valid
+        NewLineElement newLine;  // stateless, every new line in the document shares this one
+        NewTabElement newTab;
+
+    public:
+        ElementArena(string source, size_t spanCount): source(move(source)), spans(spanCount){}
+
+        const string& buffer() const{
+            return source;
+        }
+
+        // slots are disjoint, so different threads can fill different ranges at the same time
+        Element* span(size_t slot, size_t offset, size_t length, bool image){
+            spans[slot] = SpanElement(string_view(source).substr(offset, length), image);
+            return &spans[slot];
+        }
+
+        Element* new_line(){
+            return &newLine;
+        }
+
+        Element* new_tab(){
+            return &newTab;
+        }
+};
+
 // has a relationship with element class and it can have multiple elements in the document
+// the document owns its elements: single ones added through add_element and whole imported arenas
 class Document{
     private:
         vector<Element*> elements;
+        vector<unique_ptr<Element>> ownedElements;
+        vector<unique_ptr<ElementArena>> arenas;
     
     public:
+        Document() = default;
+        Document(const Document&) = delete;
+        Document& operator=(const Document&) = delete;
+
+        // takes ownership of the element
         void add_element(Element* element){
+            ownedElements.emplace_back(element);
             elements.push_back(element);
         }
 
+        // bulk importers know the element count up front, so the vector grows only once
+        void reserve(size_t count){
+            elements.reserve(elements.size() + count);
+        }
+
+        // elements created by a bulk import, they stay valid as long as the document keeps their arena
+        void add_elements(vector<Element*> newElements, unique_ptr<ElementArena> arena){
+            if(elements.empty()){
+                elements = move(newElements); // an import into an empty document keeps the importer's list
+            }else{
+                elements.insert(elements.end(), newElements.begin(), newElements.end());
+            }
+            arenas.push_back(move(arena));
+        }
+
+        size_t size() const{
+            return elements.size();
+        }
+
         vector<Element*> get_elements(){
             return elements;
         }
@@ -200,6 +275,224 @@ class DBStorage: public Persistence{
         }
 };
 
+// Versioned snapshot store: every save() is a new version, but only chunks that were never seen before hit the disk.
+// Documents are cut into content-defined chunks with a gear rolling hash, so a small edit only changes the
+// chunks around it and the rest of the document dedups against the previous versions.
+//
+// layout on disk:
+//   <root>/chunks/<chunk id>     one file per unique chunk (content addressed)
+//   <root>/versions/<n>          manifest of version n, one chunk id per line
+class ContentChunker{
+    public:
+        static constexpr size_t MIN_CHUNK = 2 * 1024;
+        static constexpr size_t MAX_CHUNK = 64 * 1024;
+        static constexpr uint64_t BOUNDARY_MASK = (1ull << 13) - 1;  // ~8 KB average chunk
+
+        // returns the end offset of every chunk in data
+        static vector<size_t> cut(const string& data){
+            static const array<uint64_t, 256> gear = make_gear_table();
+
+            vector<size_t> ends;
+            size_t start = 0;
+            while(start < data.size()){
+                size_t limit = min(data.size(), start + MAX_CHUNK);
+                size_t pos = min(limit, start + MIN_CHUNK);
+                uint64_t hash = 0;
+                for(; pos < limit; pos++){
+                    hash = (hash << 1) + gear[static_cast<unsigned char>(data[pos])];
+                    if((hash & BOUNDARY_MASK) == 0){
+                        pos++;
+                        break;
+                    }
+                }
+                ends.push_back(pos);
+                start = pos;
+            }
+            return ends;
+        }
+
+        // 128 bit content id as hex, two independent 64 bit hashes so accidental collisions are not a concern
+        static string chunk_id(const char* data, size_t length){
+            uint64_t fnv = 1469598103934665603ull;
+            uint64_t mix = 0x9E3779B97F4A7C15ull ^ length;
+            for(size_t i = 0; i < length; i++){
+                unsigned char byte = static_cast<unsigned char>(data[i]);
+                fnv = (fnv ^ byte) * 1099511628211ull;
+                mix = (mix ^ byte) * 0xff51afd7ed558ccdull;
+                mix ^= mix >> 29;
+            }
+            char id[33];
+            snprintf(id, sizeof(id), "%016llx%016llx", (unsigned long long)fnv, (unsigned long long)mix);
+            return id;
+        }
+
+    private:
+        static array<uint64_t, 256> make_gear_table(){
+            array<uint64_t, 256> table{};
+            uint64_t seed = 0x2545F4914F6CDD1Dull;
+            for(auto& value: table){
+                // splitmix64, fixed seed so chunk boundaries are stable across runs
+                seed += 0x9E3779B97F4A7C15ull;
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                value = z ^ (z >> 31);
+            }
+            return table;
+        }
+};
+
+class VersionedStorage: public Persistence{
+    private:
+        static constexpr size_t CACHE_BYTES = 8 * 1024 * 1024;
+
+        filesystem::path root;
+        size_t versionCount = 0;
+        size_t lastBytesWritten = 0;
+        unordered_set<string> storedChunks;  // ids known to be complete on disk, saves skip the exists() check
+
+        // small LRU of recently read chunks, consecutive versions share most of their chunks
+        list<pair<string, string>> cacheOrder;
+        unordered_map<string, list<pair<string, string>>::iterator> chunkCache;
+        size_t cacheBytes = 0;
+
+        filesystem::path chunk_path(const string& id) const{
+            return root / "chunks" / id;
+        }
+
+        filesystem::path version_path(size_t version) const{
+            return root / "versions" / to_string(version);
+        }
+
+        // written under a temporary name and renamed into place, so a crash never leaves a torn file
+        // under the final name (a torn chunk would otherwise be reused by every later version)
+        static bool write_file(const filesystem::path& path, const char* data, size_t length){
+            filesystem::path temp = path;
+            temp += ".tmp";
+            {
+                ofstream outFile(temp, ios::binary | ios::trunc);
+                outFile.write(data, length);
+                outFile.flush();
+                if(!outFile){
+                    return false;
+                }
+            }
+            error_code error;
+            filesystem::rename(temp, path, error);
+            return !error;
+        }
+
+        void remember(const string& id, const string& chunk){
+            if(chunk.size() > CACHE_BYTES){
+                return;
+            }
+            cacheOrder.emplace_front(id, chunk);
+            chunkCache[id] = cacheOrder.begin();
+            cacheBytes += chunk.size();
+            while(cacheBytes > CACHE_BYTES){
+                cacheBytes -= cacheOrder.back().second.size();
+                chunkCache.erase(cacheOrder.back().first);
+                cacheOrder.pop_back();
+            }
+        }
+
+        // false when the chunk is missing or its content no longer matches its id
+        bool read_chunk(const string& id, string& out){
+            auto cached = chunkCache.find(id);
+            if(cached != chunkCache.end()){
+                cacheOrder.splice(cacheOrder.begin(), cacheOrder, cached->second);
+                out += cached->second->second;
+                return true;
+            }
+            ifstream inFile(chunk_path(id), ios::binary | ios::ate);
+            if(!inFile.is_open()){
+                return false;
+            }
+            string chunk(static_cast<size_t>(inFile.tellg()), '\0');
+            inFile.seekg(0);
+            inFile.read(chunk.data(), chunk.size());
+            if(!inFile || ContentChunker::chunk_id(chunk.data(), chunk.size()) != id){
+                return false;
+            }
+            out += chunk;
+            remember(id, chunk);
+            return true;
+        }
+
+    public:
+        VersionedStorage(const string& rootPath): root(rootPath){
+            filesystem::create_directories(root / "chunks");
+            filesystem::create_directories(root / "versions");
+            while(filesystem::exists(version_path(versionCount))){
+                versionCount++;
+            }
+        }
+
+        // writes only the chunks that are not stored yet plus a small manifest
+        // the version is only published (manifest renamed into place) once all of its chunks are on disk
+        void save(string data) override{
+            lastBytesWritten = 0;
+            string manifest;
+            size_t start = 0;
+            for(size_t end: ContentChunker::cut(data)){
+                string id = ContentChunker::chunk_id(data.data() + start, end - start);
+                manifest += id + "\n";
+
+                if(!storedChunks.count(id) && !filesystem::exists(chunk_path(id))){
+                    if(!write_file(chunk_path(id), data.data() + start, end - start)){
+                        cerr << "Snapshot not saved: could not write chunk " << id << endl;
+                        return;
+                    }
+                    lastBytesWritten += end - start;
+                }
+                storedChunks.insert(id);
+                start = end;
+            }
+
+            if(!write_file(version_path(versionCount), manifest.data(), manifest.size())){
+                cerr << "Snapshot not saved: could not write manifest " << versionCount << endl;
+                return;
+            }
+            lastBytesWritten += manifest.size();
+            versionCount++;
+        }
+
+        // latest version, empty when there is none or it cannot be restored
+        string load() override{
+            string data;
+            if(versionCount > 0 && !load_version(versionCount - 1, data)){
+                cerr << "Snapshot " << versionCount - 1 << " is missing or corrupted chunks" << endl;
+                return "";
+            }
+            return data;
+        }
+
+        // false (and data left empty) when the version does not exist or a chunk is missing or corrupted
+        bool load_version(size_t version, string& data){
+            data.clear();
+            ifstream inFile(version_path(version));
+            if(version >= versionCount || !inFile.is_open()){
+                return false;
+            }
+            string id;
+            while(getline(inFile, id)){
+                if(!read_chunk(id, data)){
+                    data.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t version_count() const{
+            return versionCount;
+        }
+
+        size_t last_bytes_written() const{
+            return lastBytesWritten;
+        }
+};
+
 //  it will create a new Element pointer object based on the type of element we want to add
 enum class ElementType { TEXT, IMAGE, NEW_LINE, NEW_TAB };
 
@@ -224,6 +517,188 @@ class ElementFactory{
 };
 
 
+// Bulk import of large text / markdown files into a Document.
+// Instead of one factory call (and one console line) per element, the file is read once,
+// tokenized into compact (type, offset, length) tokens and then turned into elements in one go.
+
+// compact token produced by the tokenizer, it only points into the source buffer
+struct Token{
+    ElementType type;
+    size_t offset;
+    size_t length;
+};
+
+class BulkTokenizer{
+    public:
+        // tokenizes buffer[begin, end), every line is either an image or text separated by tabs
+        // memchr does the byte scanning so the hot loop runs on the libc vectorized search
+        static void tokenize(const string& buffer, size_t begin, size_t end, vector<Token>& tokens){
+            const char* data = buffer.data();
+            size_t pos = begin;
+            while(pos < end){
+                const char* newLine = static_cast<const char*>(memchr(data + pos, '\n', end - pos));
+                size_t lineEnd = newLine ? newLine - data : end;
+
+                tokenize_line(data, pos, lineEnd, tokens);
+
+                if(newLine){
+                    tokens.push_back({ElementType::NEW_LINE, lineEnd, 1});
+                    pos = lineEnd + 1;
+                }else{
+                    pos = end;
+                }
+            }
+        }
+
+        // splits the buffer on line boundaries and tokenizes every chunk on its own thread
+        static vector<vector<Token>> tokenize_parallel(const string& buffer, unsigned threads){
+            threads = max(1u, threads);
+            vector<size_t> bounds{0};
+            for(unsigned i = 1; i < threads; i++){
+                size_t cut = max(bounds.back(), buffer.size() * i / threads);
+                const char* newLine = static_cast<const char*>(memchr(buffer.data() + cut, '\n', buffer.size() - cut));
+                bounds.push_back(newLine ? newLine - buffer.data() + 1 : buffer.size());
+            }
+            bounds.push_back(buffer.size());
+
+            vector<vector<Token>> chunks(threads);
+            vector<thread> workers;
+            for(unsigned i = 0; i < threads; i++){
+                workers.emplace_back([&, i](){
+                    // rough guess of one token per 16 bytes avoids most regrowth
+                    chunks[i].reserve((bounds[i + 1] - bounds[i]) / 16 + 1);
+                    tokenize(buffer, bounds[i], bounds[i + 1], chunks[i]);
+                });
+            }
+            for(auto& worker: workers){
+                worker.join();
+            }
+            return chunks;
+        }
+
+    private:
+        static void tokenize_line(const char* data, size_t begin, size_t end, vector<Token>& tokens){
+            if(end > begin && data[end - 1] == '\r'){
+                end--;
+            }
+            if(match_image(data, begin, end, tokens)){
+                return;
+            }
+
+            size_t pos = begin;
+            while(pos < end){
+                const char* tab = static_cast<const char*>(memchr(data + pos, '\t', end - pos));
+                size_t textEnd = tab ? tab - data : end;
+                if(textEnd > pos){
+                    tokens.push_back({ElementType::TEXT, pos, textEnd - pos});
+                }
+                if(!tab){
+                    break;
+                }
+                tokens.push_back({ElementType::NEW_TAB, textEnd, 1});
+                pos = textEnd + 1;
+            }
+        }
+
+        // markdown "![alt](path)" or our own rendered "[ Image : path ]" on a line of its own
+        static bool match_image(const char* data, size_t begin, size_t end, vector<Token>& tokens){
+            string_view line(data + begin, end - begin);
+
+            const string_view rendered = "[ Image : ";
+            if(line.size() > rendered.size() + 2 && line.substr(0, rendered.size()) == rendered && line.substr(line.size() - 2) == " ]"){
+                tokens.push_back({ElementType::IMAGE, begin + rendered.size(), line.size() - rendered.size() - 2});
+                return true;
+            }
+
+            if(line.size() > 4 && line.substr(0, 2) == "![" && line.back() == ')'){
+                size_t open = line.find("](");
+                if(open != string_view::npos){
+                    tokens.push_back({ElementType::IMAGE, begin + open + 2, line.size() - open - 3});
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+class BulkImporter{
+    private:
+        static bool is_span(const Token& token){
+            return token.type == ElementType::TEXT || token.type == ElementType::IMAGE;
+        }
+
+        // `spanSlot` is the next free span slot of the chunk, advanced for text and image tokens only
+        static Element* make(ElementArena& arena, size_t& spanSlot, const Token& token){
+            switch(token.type){
+                case ElementType::TEXT:
+                    return arena.span(spanSlot++, token.offset, token.length, false);
+                case ElementType::IMAGE:
+                    return arena.span(spanSlot++, token.offset, token.length, true);
+                case ElementType::NEW_LINE:
+                    return arena.new_line();
+                case ElementType::NEW_TAB:
+                    return arena.new_tab();
+                default:
+                    return nullptr;
+            }
+        }
+
+        static bool read_file(const string& filePath, string& buffer){
+            ifstream inFile(filePath, ios::binary | ios::ate);
+            if(!inFile.is_open()){
+                return false;
+            }
+            buffer.resize(static_cast<size_t>(inFile.tellg()));
+            inFile.seekg(0);
+            inFile.read(buffer.data(), buffer.size());
+            return static_cast<bool>(inFile);
+        }
+
+    public:
+        // returns the number of elements appended to the document, which takes over the buffer
+        // tokenizing and materializing both run per chunk on their own thread
+        static size_t import_text(Document* document, string buffer, unsigned threads = thread::hardware_concurrency()){
+            vector<vector<Token>> chunks = BulkTokenizer::tokenize_parallel(buffer, threads);
+
+            // every chunk fills its own slice of the element list and of the arena's spans;
+            // new lines and tabs share the arena's single elements, so only text and image tokens get a span
+            vector<size_t> firstSlot{0}, firstSpan{0};
+            for(const auto& chunk: chunks){
+                firstSlot.push_back(firstSlot.back() + chunk.size());
+                firstSpan.push_back(firstSpan.back() + count_if(chunk.begin(), chunk.end(), is_span));
+            }
+            size_t count = firstSlot.back();
+
+            auto arena = make_unique<ElementArena>(move(buffer), firstSpan.back());
+            vector<Element*> elements(count);
+            vector<thread> workers;
+            for(size_t c = 0; c < chunks.size(); c++){
+                workers.emplace_back([&, c](){
+                    size_t spanSlot = firstSpan[c];
+                    for(size_t i = 0; i < chunks[c].size(); i++){
+                        elements[firstSlot[c] + i] = make(*arena, spanSlot, chunks[c][i]);
+                    }
+                    vector<Token>().swap(chunks[c]); // the tokens are done with, give their memory back early
+                });
+            }
+            for(auto& worker: workers){
+                worker.join();
+            }
+
+            document->add_elements(move(elements), move(arena));
+            return count;
+        }
+
+        static size_t import_file(Document* document, const string& filePath, unsigned threads = thread::hardware_concurrency()){
+            string buffer;
+            if(!read_file(filePath, buffer)){
+                return 0;
+            }
+            return import_text(document, move(buffer), threads);
+        }
+};
+
+
 class Editor{
     private:
         Document* document;
@@ -246,6 +721,12 @@ class Editor{
             }
         }
 
+        // bulk mode: the whole file becomes elements in one pass, with a single status line
+        void import_document(const string& filePath){
+            size_t count = BulkImporter::import_file(document, filePath);
+            cout << "Imported " << count << " elements from " << filePath << endl;
+        }
+
         void render_document(){
             currentDocumentData = renderer->render();
             cout << "Rendered Document:\n" << currentDocumentData << endl;
@@ -269,7 +750,29 @@ class Editor{
         }
 };
 
-int main(){
+// in-memory import throughput on a generated document, one thread vs all threads
+void benchmark_import(size_t megabytes){
+    string line = "Lorem ipsum dolor sit amet, consectetur adipiscing elit\tsed do eiusmod tempor incididunt\n";
+    string image = "![figure](images/figure.png)\n";
+    string source;
+    source.reserve(megabytes << 20);
+    for(size_t i = 0; source.size() < (megabytes << 20); i++){
+        source += i % 20 == 19 ? image : line;
+    }
+
+    for(unsigned threads: set<unsigned>{1u, max(1u, thread::hardware_concurrency())}){
+        Document document;
+        string copy = source;
+        auto start = chrono::steady_clock::now();
+        size_t count = BulkImporter::import_text(&document, move(copy), threads);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Imported " << megabytes << " MB (" << count << " elements) on " << threads << " thread(s): "
+             << megabytes / seconds << " MB/s" << endl;
+    }
+}
+
+// pass --benchmark to also run the import benchmark, it needs well over 1 GB of memory
+int main(int argc, char** argv){
 
     Document* doc = new Document();
     RenderElement* renderer = new RenderElement(doc);
@@ -289,6 +792,28 @@ int main(){
 
     editor->load_document();
 
+    // bulk import the saved file back into a fresh document
+    Document* importedDoc = new Document();
+    RenderElement* importedRenderer = new RenderElement(importedDoc);
+    Editor* importEditor = new Editor(importedDoc, importedRenderer, fileStorage);
+    importEditor->import_document("document.txt");
+    importEditor->render_document();
+
+    // versioned snapshots: the second save after a small edit only writes the changed chunks
+    VersionedStorage* snapshots = new VersionedStorage("snapshots");
+    string contents = renderer->render();
+    snapshots->save(contents);
+    snapshots->save(contents + "One more line.");
+    cout << "Versions stored: " << snapshots->version_count() << ", bytes written by last save: " << snapshots->last_bytes_written() << endl;
+
+    if(argc > 1 && string(argv[1]) == "--benchmark"){
+        benchmark_import(256);
+    }
+
+    delete snapshots;
+    delete importEditor;
+    delete importedRenderer;
+    delete importedDoc;
     delete editor;
     delete fileStorage;
     delete renderer;
@@ -4,31 +4,223 @@ using namespace std;
 
 
 
-// abstract class / interface for persistence 
+// one unit of application data, addressed by key
+struct Record{
+    string key;
+    string value;
+};
+
+
+// abstract class / interface for persistence
 class Persistence{
 
     public:
-        virtual void save() = 0;
+        virtual void save(const Record& record) = 0;
+
+        // batched write - backends override it to store the whole batch in one round trip
+        virtual void saveMany(const vector<Record>& records){
+            for(const Record& record : records){
+                save(record);
+            }
+        }
+
+        virtual optional<string> load(const string& key) = 0;
+
+        // blocks until every accepted write is stored; only write-behind implementations need it
+        virtual void flush() {}
+
         virtual ~Persistence() = default;
 };
 
 
+// stands in for the network hop to a database server: every call pays a fixed latency and is counted
+class SimulatedLink{
+    private:
+        chrono::microseconds latency;
+        atomic<size_t> trips{0};
+
+    public:
+        explicit SimulatedLink(chrono::microseconds latency): latency(latency) {}
+
+        void roundTrip(){
+            trips.fetch_add(1, memory_order_relaxed);
+            if(latency.count() > 0){
+                this_thread::sleep_for(latency);
+            }
+        }
+
+        size_t count() const {
+            return trips.load(memory_order_relaxed);
+        }
+};
+
+
 // Concrete implementations of Persistence interface for different storage types
+// MySQL stand-in: an embedded row store with an auto increment id and a primary key index on `key`
 class MySQl: public Persistence{
+    private:
+        struct Row{
+            int64_t id;
+            string key;
+            string value;
+        };
+
+        vector<Row> rows;
+        unordered_map<string, size_t> primaryKey;
+        int64_t nextId = 1;
+        mutable mutex tableLock;
+        SimulatedLink link;
+
+        // INSERT ... ON DUPLICATE KEY UPDATE, caller holds tableLock
+        void upsert(const Record& record){
+            auto it = primaryKey.find(record.key);
+            if(it != primaryKey.end()){
+                rows[it->second].value = record.value;
+            }else{
+                primaryKey.emplace(record.key, rows.size());
+                rows.push_back({nextId++, record.key, record.value});
+            }
+        }
 
     public:
-        void save() override{
-            cout<<"Saving to MySQL database"<<endl;
+        explicit MySQl(chrono::microseconds latency = chrono::microseconds(50)): link(latency) {}
+
+        void save(const Record& record) override{
+            link.roundTrip();
+            lock_guard<mutex> lock(tableLock);
+            upsert(record);
+        }
+
+        // one multi-row statement in a single transaction
+        void saveMany(const vector<Record>& records) override{
+            link.roundTrip();
+            lock_guard<mutex> lock(tableLock);
+            for(const Record& record : records){
+                upsert(record);
+            }
+        }
+
+        optional<string> load(const string& key) override{
+            link.roundTrip();
+            lock_guard<mutex> lock(tableLock);
+            auto it = primaryKey.find(key);
+            if(it == primaryKey.end()){
+                return nullopt;
+            }
+            return rows[it->second].value;
+        }
+
+        size_t roundTrips() const {
+            return link.count();
+        }
+
+        size_t rowCount() const {
+            lock_guard<mutex> lock(tableLock);
+            return rows.size();
         }
 };
 
 
 // Another implementation of Persistence interface for MongoDB
+// MongoDB stand-in: a document store keeping each record as a serialized document,
+// split over lock-striped partitions so writes to different keys rarely contend
 class MongoDB : public Persistence{
+    private:
+        static constexpr size_t PARTITIONS = 16;
+
+        struct Partition{
+            mutex lock;
+            unordered_map<string, string> documents; // _id -> {"_id":...,"value":...}
+        };
+
+        array<Partition, PARTITIONS> partitions;
+        SimulatedLink link;
+
+        static void appendEscaped(string& out, const string& text){
+            for(char c : text){
+                if(c == '"' || c == '\\'){
+                    out += '\\';
+                }
+                out += c;
+            }
+        }
+
+        static string toDocument(const Record& record){
+            string document = "{\"_id\":\"";
+            appendEscaped(document, record.key);
+            document += "\",\"value\":\"";
+            appendEscaped(document, record.value);
+            document += "\"}";
+            return document;
+        }
+
+        static string valueOf(const string& document){
+            size_t start = document.find("\",\"value\":\"") + 11;
+            string value;
+            for(size_t i = start; i + 2 < document.size(); i++){
+                if(document[i] == '\\'){
+                    i++;
+                }
+                value += document[i];
+            }
+            return value;
+        }
+
+        Partition& partitionOf(const string& key){
+            return partitions[hash<string>{}(key) % PARTITIONS];
+        }
 
     public:
-        void save() override{
-            cout<<"Saving to MongoDB database"<<endl;
+        explicit MongoDB(chrono::microseconds latency = chrono::microseconds(50)): link(latency) {}
+
+        void save(const Record& record) override{
+            link.roundTrip();
+            string document = toDocument(record);
+            Partition& partition = partitionOf(record.key);
+            lock_guard<mutex> lock(partition.lock);
+            partition.documents[record.key] = move(document);
+        }
+
+        // insertMany: one round trip, documents grouped by partition so each lock is taken once
+        void saveMany(const vector<Record>& records) override{
+            link.roundTrip();
+            array<vector<const Record*>, PARTITIONS> grouped;
+            for(const Record& record : records){
+                grouped[hash<string>{}(record.key) % PARTITIONS].push_back(&record);
+            }
+            for(size_t p = 0; p < PARTITIONS; p++){
+                if(grouped[p].empty()){
+                    continue;
+                }
+                lock_guard<mutex> lock(partitions[p].lock);
+                for(const Record* record : grouped[p]){
+                    partitions[p].documents[record->key] = toDocument(*record);
+                }
+            }
+        }
+
+        optional<string> load(const string& key) override{
+            link.roundTrip();
+            Partition& partition = partitionOf(key);
+            lock_guard<mutex> lock(partition.lock);
+            auto it = partition.documents.find(key);
+            if(it == partition.documents.end()){
+                return nullopt;
+            }
+            return valueOf(it->second);
+        }
+
+        size_t roundTrips() const {
+            return link.count();
+        }
+
+        size_t documentCount(){
+            size_t count = 0;
+            for(Partition& partition : partitions){
+                lock_guard<mutex> lock(partition.lock);
+                count += partition.documents.size();
+            }
+            return count;
         }
 };
 
@@ -40,22 +232,385 @@ class Application{
     public:
         Application(Persistence& p): persistence(p) {}
 
-        void saveData(){
-            persistence.save();
+        void saveData(const string& key, const string& value){
+            persistence.save({key, value});
+        }
+
+        void saveAll(const vector<Record>& records){
+            persistence.saveMany(records);
+        }
+
+        optional<string> loadData(const string& key){
+            return persistence.load(key);
+        }
+
+        void flush(){
+            persistence.flush();
         }
 };
 
 
+// Persistence front-end that sits between Application and any backend(s).
+// - keys are sharded over the backends, and each backend is reached through `poolSize` lanes that act
+//   as separate connections, each with its own flusher thread, so flushes run in parallel
+// - save() only buffers the record in its lane (the same key always maps to the same lane, so writes
+//   to a key reach the backend in order); repeated writes to a buffered key are combined, and the
+//   flusher sends the buffer with one saveMany when it reaches maxBatch or after maxDelay
+// - load() is read-through: buffered, in-flight and cached values are served locally, misses go to
+//   the backend once and are cached (LRU per lane)
+struct FrontEndOptions{
+    size_t poolSize = 4;                              // lanes (connections) per backend
+    size_t maxBatch = 256;
+    chrono::microseconds maxDelay{500};               // oldest buffered write waits at most this long
+    size_t maxPending = 4096;                         // per lane; save() blocks beyond it
+    size_t cacheCapacity = 65536;                     // records, split over the lanes
+};
+
+class PersistenceFrontEnd : public Persistence{
+    private:
+        struct Lane{
+            Persistence* backend = nullptr;
+            mutex lock;
+            condition_variable wake;                  // flusher: work arrived / flush requested / stop
+            condition_variable idle;                  // writers: batch written
+            vector<Record> pending;
+            unordered_map<string, size_t> pendingIndex;
+            vector<Record> writing;                   // batch currently sent to the backend
+            unordered_map<string, size_t> writingIndex;
+            list<Record> lru;
+            unordered_map<string, list<Record>::iterator> cached;
+            size_t flushRequests = 0;
+            bool stopping = false;
+            size_t combined = 0, batches = 0, hits = 0, misses = 0;
+            thread flusher;
+        };
+
+        FrontEndOptions options;
+        size_t shards;
+        vector<unique_ptr<Lane>> lanes;
+
+        Lane& laneOf(const string& key){
+            size_t h = hash<string>{}(key);
+            return *lanes[(h % shards) * options.poolSize + (h / shards) % options.poolSize];
+        }
+
+        // caller holds lane.lock
+        void remember(Lane& lane, const Record& record){
+            auto it = lane.cached.find(record.key);
+            if(it != lane.cached.end()){
+                it->second->value = record.value;
+                lane.lru.splice(lane.lru.begin(), lane.lru, it->second);
+                return;
+            }
+            lane.lru.push_front(record);
+            lane.cached.emplace(record.key, lane.lru.begin());
+            if(lane.cached.size() > max<size_t>(1, options.cacheCapacity / lanes.size())){
+                lane.cached.erase(lane.lru.back().key);
+                lane.lru.pop_back();
+            }
+        }
+
+        // newest value known to the front-end, caller holds lane.lock
+        const string* lookup(Lane& lane, const string& key){
+            auto pending = lane.pendingIndex.find(key);
+            if(pending != lane.pendingIndex.end()){
+                return &lane.pending[pending->second].value;
+            }
+            auto writing = lane.writingIndex.find(key);
+            if(writing != lane.writingIndex.end()){
+                return &lane.writing[writing->second].value;
+            }
+            auto cached = lane.cached.find(key);
+            if(cached != lane.cached.end()){
+                lane.lru.splice(lane.lru.begin(), lane.lru, cached->second);
+                return &cached->second->value;
+            }
+            return nullptr;
+        }
+
+        void runFlusher(Lane& lane){
+            unique_lock<mutex> lock(lane.lock);
+            while(true){
+                lane.wake.wait(lock, [&](){ return lane.stopping || !lane.pending.empty(); });
+                if(lane.pending.empty()){
+                    return; // stopping and drained
+                }
+                lane.wake.wait_for(lock, options.maxDelay, [&](){
+                    return lane.stopping || lane.flushRequests > 0 || lane.pending.size() >= options.maxBatch;
+                });
+
+                lane.writing.swap(lane.pending);
+                lane.writingIndex.swap(lane.pendingIndex);
+                lock.unlock();
+                lane.backend->saveMany(lane.writing);
+                lock.lock();
+                lane.writing.clear();
+                lane.writingIndex.clear();
+                lane.batches++;
+                lane.idle.notify_all();
+            }
+        }
+
+    public:
+        PersistenceFrontEnd(const vector<Persistence*>& backends, FrontEndOptions options = {})
+            : options(options), shards(backends.size()){
+            this->options.poolSize = max<size_t>(1, options.poolSize);
+            for(Persistence* backend : backends){
+                for(size_t i = 0; i < this->options.poolSize; i++){
+                    lanes.push_back(make_unique<Lane>());
+                    lanes.back()->backend = backend;
+                }
+            }
+            for(auto& lane : lanes){
+                lane->flusher = thread(&PersistenceFrontEnd::runFlusher, this, ref(*lane));
+            }
+        }
+
+        PersistenceFrontEnd(Persistence& backend, FrontEndOptions options = {})
+            : PersistenceFrontEnd(vector<Persistence*>{&backend}, options) {}
+
+        // buffered writes are written out before the backends go away
+        ~PersistenceFrontEnd(){
+            for(auto& lane : lanes){
+                lock_guard<mutex> lock(lane->lock);
+                lane->stopping = true;
+                lane->wake.notify_all();
+            }
+            for(auto& lane : lanes){
+                lane->flusher.join();
+            }
+        }
+
+        void save(const Record& record) override{
+            Lane& lane = laneOf(record.key);
+            unique_lock<mutex> lock(lane.lock);
+            lane.idle.wait(lock, [&](){ return lane.pending.size() < options.maxPending; });
+            auto it = lane.pendingIndex.find(record.key);
+            if(it != lane.pendingIndex.end()){
+                lane.pending[it->second].value = record.value;
+                lane.combined++;
+            }else{
+                lane.pendingIndex.emplace(record.key, lane.pending.size());
+                lane.pending.push_back(record);
+            }
+            remember(lane, record);
+            if(lane.pending.size() == 1 || lane.pending.size() >= options.maxBatch){
+                lane.wake.notify_one();
+            }
+        }
+
+        void saveMany(const vector<Record>& records) override{
+            for(const Record& record : records){
+                save(record);
+            }
+        }
+
+        optional<string> load(const string& key) override{
+            Lane& lane = laneOf(key);
+            {
+                lock_guard<mutex> lock(lane.lock);
+                if(const string* value = lookup(lane, key)){
+                    lane.hits++;
+                    return *value;
+                }
+                lane.misses++;
+            }
+            optional<string> stored = lane.backend->load(key);
+            lock_guard<mutex> lock(lane.lock);
+            // a write that arrived during the backend read is newer than what we read
+            if(const string* value = lookup(lane, key)){
+                return *value;
+            }
+            if(stored){
+                remember(lane, {key, *stored});
+            }
+            return stored;
+        }
+
+        void flush() override{
+            for(auto& lane : lanes){
+                unique_lock<mutex> lock(lane->lock);
+                lane->flushRequests++;
+                lane->wake.notify_all();
+                lane->idle.wait(lock, [&](){ return lane->pending.empty() && lane->writing.empty(); });
+                lane->flushRequests--;
+            }
+        }
+
+        struct Stats{
+            size_t combined = 0, batches = 0, hits = 0, misses = 0;
+        };
+
+        Stats stats(){
+            Stats total;
+            for(auto& lane : lanes){
+                lock_guard<mutex> lock(lane->lock);
+                total.combined += lane->combined;
+                total.batches += lane->batches;
+                total.hits += lane->hits;
+                total.misses += lane->misses;
+            }
+            return total;
+        }
+};
+
+
+// Load harness: `threads` clients share one Application and write `writesPerThread` records each,
+// either one saveData call per record (batchSize == 1) or saveAll calls of batchSize records.
+// Latency is measured per call.
+struct LoadConfig{
+    unsigned threads = 8;
+    size_t writesPerThread = 2000;
+    size_t batchSize = 1;
+    size_t valueBytes = 64;
+    size_t keySpace = 1000; // distinct keys per thread, so some writes overwrite earlier ones
+};
+
+struct LoadReport{
+    size_t writes = 0;
+    double seconds = 0;
+    double p50Us = 0, p99Us = 0, p999Us = 0;
+};
+
+LoadReport runLoad(Persistence& backend, const LoadConfig& config){
+    Application app(backend);
+    vector<vector<double>> latencies(config.threads);
+    vector<thread> clients;
+
+    auto start = chrono::steady_clock::now();
+    for(unsigned t = 0; t < config.threads; t++){
+        clients.emplace_back([&, t](){
+            string value(config.valueBytes, static_cast<char>('a' + t % 26));
+            vector<Record> batch;
+            auto timed = [&](auto&& call){
+                auto begin = chrono::steady_clock::now();
+                call();
+                latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+            };
+            for(size_t i = 0; i < config.writesPerThread; i++){
+                string key = "user:" + to_string(t) + ":" + to_string(i % config.keySpace);
+                if(config.batchSize <= 1){
+                    timed([&](){ app.saveData(key, value); });
+                    continue;
+                }
+                batch.push_back({move(key), value});
+                if(batch.size() == config.batchSize || i + 1 == config.writesPerThread){
+                    timed([&](){ app.saveAll(batch); });
+                    batch.clear();
+                }
+            }
+        });
+    }
+    for(auto& client : clients){
+        client.join();
+    }
+    app.flush(); // write-behind backends count as done only once everything is stored
+
+    LoadReport report;
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report.writes = config.threads * config.writesPerThread;
+    vector<double> all;
+    for(auto& samples : latencies){
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    sort(all.begin(), all.end());
+    auto percentile = [&](double p){ return all.empty() ? 0.0 : all[static_cast<size_t>(p * (all.size() - 1))]; };
+    report.p50Us = percentile(0.50);
+    report.p99Us = percentile(0.99);
+    report.p999Us = percentile(0.999);
+    return report;
+}
+
+void printReport(const string& name, const LoadReport& report, size_t roundTrips){
+    cout<<name<<": "<<static_cast<size_t>(report.writes / report.seconds)<<" writes/s, call latency p50 "<<report.p50Us
+        <<" us, p99 "<<report.p99Us<<" us, p99.9 "<<report.p999Us<<" us, "<<roundTrips<<" round trips"<<endl;
+}
+
+// every backend against the same load, one record per call and then batches of 64
+void benchmarkBackends(const LoadConfig& base){
+    for(size_t batchSize : {size_t(1), size_t(64)}){
+        LoadConfig config = base;
+        config.batchSize = batchSize;
+        string mode = batchSize == 1 ? " (saveData)" : " (saveAll x" + to_string(batchSize) + ")";
+
+        MySQl mysql;
+        LoadReport report = runLoad(mysql, config);
+        printReport("MySQL row store" + mode, report, mysql.roundTrips());
+
+        MongoDB mongo;
+        report = runLoad(mongo, config);
+        printReport("MongoDB document store" + mode, report, mongo.roundTrips());
+    }
+}
+
+
+// direct backend vs the front-end over the same backend, then sharded over two backends;
+// afterwards the same keys are read back to show the read-through cache
+void benchmarkFrontEnd(const LoadConfig& config){
+    auto readBack = [&](Persistence& persistence){
+        Application app(persistence);
+        size_t found = 0;
+        auto start = chrono::steady_clock::now();
+        for(unsigned t = 0; t < config.threads; t++){
+            for(size_t i = 0; i < 250; i++){
+                found += app.loadData("user:" + to_string(t) + ":" + to_string(i)).has_value();
+            }
+        }
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        return make_pair(found, us / (config.threads * 250));
+    };
+
+    {
+        MySQl mysql;
+        LoadReport report = runLoad(mysql, config);
+        printReport("MySQL direct", report, mysql.roundTrips());
+        auto [found, us] = readBack(mysql);
+        cout<<"  read back "<<found<<" keys, "<<us<<" us/load"<<endl;
+    }
+    {
+        MySQl mysql;
+        PersistenceFrontEnd frontEnd(mysql);
+        LoadReport report = runLoad(frontEnd, config);
+        printReport("MySQL via front-end", report, mysql.roundTrips());
+        auto [found, us] = readBack(frontEnd);
+        auto stats = frontEnd.stats();
+        cout<<"  "<<stats.batches<<" batches, "<<stats.combined<<" writes combined; read back "<<found<<" keys, "<<us
+            <<" us/load, cache hits "<<stats.hits<<", misses "<<stats.misses<<endl;
+    }
+    {
+        MongoDB mongo;
+        PersistenceFrontEnd frontEnd(mongo);
+        LoadReport report = runLoad(frontEnd, config);
+        printReport("MongoDB via front-end", report, mongo.roundTrips());
+    }
+    {
+        MySQl first, second;
+        PersistenceFrontEnd frontEnd({&first, &second});
+        LoadReport report = runLoad(frontEnd, config);
+        printReport("2 x MySQL sharded via front-end", report, first.roundTrips() + second.roundTrips());
+        cout<<"  rows per shard: "<<first.rowCount()<<" / "<<second.rowCount()<<endl;
+    }
+}
+
+
 int main(){
 
     // creating a MySQL persistence and using it in the application
     MySQl mysql; // using parent interface type for flexibility
     Application app1(mysql); // injecting MySQL persistence into the application
-    app1.saveData(); // client code only depends on Persistence interface, not on MySQL-specific details
+    app1.saveData("greeting", "hello from MySQL"); // client code only depends on Persistence interface, not on MySQL-specific details
+    cout<<"MySQL: "<<app1.loadData("greeting").value_or("<missing>")<<endl;
 
     MongoDB mongo; // using parent interface type for flexibility
     Application app2(mongo); // injecting MongoDB persistence into the application
-    app2.saveData(); // client code only depends on Persistence interface, not on MongoDB-specific details
+    app2.saveData("greeting", "hello from \"MongoDB\""); // client code only depends on Persistence interface, not on MongoDB-specific details
+    cout<<"MongoDB: "<<app2.loadData("greeting").value_or("<missing>")<<endl;
+
+    LoadConfig config;
+    config.threads = 8;
+    config.writesPerThread = 2000;
+    benchmarkBackends(config);
+    benchmarkFrontEnd(config);
 
     return 0;
-}
\ No newline at end of file
+}
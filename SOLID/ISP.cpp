@@ -3,12 +3,13 @@
 
 #include<iostream>
 #include<bits/stdc++.h>
+#include "../common/WorkerPool.h"
 using namespace std;
 
 // Basic interface for 2D shapes - only requires area calculation
 class Shape{
     public:
-    virtual void area()=0;
+    virtual double area()=0;
     virtual ~Shape() = default;
 };
 
@@ -16,27 +17,89 @@ class Shape{
 // Follows ISP by separating 3D-specific behavior into its own interface
 class shape3d : public Shape{
     public:
-    virtual void area()=0;
-    virtual void volume() = 0;
+    virtual double area()=0;
+    virtual double volume() = 0;
     virtual ~shape3d() = default;
 };
 
-// 2D shape implementation - only implements what it needs (area)
-class circle: public Shape{
+struct Point{
+    double x = 0, y = 0, z = 0;
+};
+
+// axis aligned bounding box
+struct Box{
+    Point min, max;
+
+    bool intersects(const Box& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x
+            && min.y <= other.max.y && other.min.y <= max.y
+            && min.z <= other.max.z && other.min.z <= max.z;
+    }
+};
+
+// Segregated interface for shapes placed in a scene - only what spatial queries need.
+// Shapes that are never placed do not have to implement it.
+class Locatable{
     public:
-    void area() override{
-        cout<<"Area of circle is pi*r^2"<<endl;
+    virtual Box bounds() const = 0;
+    virtual double distanceTo(const Point& p) const = 0;  // 0 when p is inside the shape
+    virtual ~Locatable() = default;
+};
+
+// 2D shape implementation - only implements what it needs (area), plus a position in the scene (z = 0 plane)
+class circle: public Shape, public Locatable{
+    private:
+    double radius;
+    Point center;
+
+    public:
+    circle(double radius, Point center = {}): radius(radius), center(center) {}
+
+    double getRadius() const { return radius; }
+
+    // pi*r^2
+    double area() override{
+        return M_PI * radius * radius;
+    }
+
+    Box bounds() const override{
+        return {{center.x - radius, center.y - radius, center.z}, {center.x + radius, center.y + radius, center.z}};
+    }
+
+    double distanceTo(const Point& p) const override{
+        double inPlane = max(0.0, hypot(p.x - center.x, p.y - center.y) - radius);
+        return hypot(inPlane, p.z - center.z);
     }
 };
 
 // 3D shape implementation - implements both area and volume
-class Sphere: public shape3d{
+class Sphere: public shape3d, public Locatable{
+    private:
+    double radius;
+    Point center;
+
     public:
-    void area() override{
-        cout<<"Area of sphere is 4*pi*r^2"<<endl;
+    Sphere(double radius, Point center = {}): radius(radius), center(center) {}
+
+    double getRadius() const { return radius; }
+
+    // 4*pi*r^2
+    double area() override{
+        return 4 * M_PI * radius * radius;
+    }
+
+    // (4/3)*pi*r^3
+    double volume() override{
+        return 4.0 / 3.0 * M_PI * radius * radius * radius;
+    }
+
+    Box bounds() const override{
+        return {{center.x - radius, center.y - radius, center.z - radius}, {center.x + radius, center.y + radius, center.z + radius}};
     }
-    void volume() override{
-        cout<<"Volume of sphere is (4/3)*pi*r^3"<<endl;
+
+    double distanceTo(const Point& p) const override{
+        return max(0.0, sqrt((p.x - center.x) * (p.x - center.x) + (p.y - center.y) * (p.y - center.y)
+                           + (p.z - center.z) * (p.z - center.z)) - radius);
     }
 };
 
@@ -48,20 +111,709 @@ class Client{
     public:
     Client(Shape* s): shape(s) {}
     void displayArea(){
-        shape->area();
+        cout<<"Area: "<<shape->area()<<endl;
+    }
+};
+
+
+// the pool shared by the batch kernels and the spatial index in this file, started on first use
+WorkerPool& shapePool(){
+    static WorkerPool pool;
+    return pool;
+}
+
+
+// Batch geometry for large shape collections.
+// Shapes are stored by type as plain arrays (structure of arrays): all circle radii together, all sphere
+// radii together. Every kernel is then one simple loop over one array, and the arrays are split into
+// chunks that run on the shared worker pool. The kernels step 4 shapes at a time through __restrict
+// pointers: GCC 12 and later vectorize that at plain -O2, while the straight loop only vectorizes at -O3
+// (the -O2 cost model refuses the runtime alias check and remainder loop it needs). Older GCC needs -O3.
+// Every shape offered to the batch gets a position in ingest order (add() calls and addAll() elements,
+// skipped ones included); circleShape(i) / sphereShape(i) map a result back to that position.
+class ShapeBatch{
+    private:
+    vector<double> circleRadii;
+    vector<double> sphereRadii;
+    vector<size_t> circleSources;
+    vector<size_t> sphereSources;
+    vector<size_t> skippedShapes;
+    size_t offered = 0;
+    static constexpr size_t CHUNK = 1 << 16;
+
+    static void circleKernel(const double* __restrict r, double* __restrict area, size_t begin, size_t end){
+        size_t i = begin;
+        for(; i + 4 <= end; i += 4){
+            for(size_t j = 0; j < 4; j++){
+                area[i + j] = M_PI * r[i + j] * r[i + j];
+            }
+        }
+        for(; i < end; i++){
+            area[i] = M_PI * r[i] * r[i];
+        }
+    }
+
+    static void sphereKernel(const double* __restrict r, double* __restrict area, double* __restrict volume, size_t begin, size_t end){
+        size_t i = begin;
+        for(; i + 4 <= end; i += 4){
+            for(size_t j = 0; j < 4; j++){
+                double squared = r[i + j] * r[i + j];
+                area[i + j] = 4 * M_PI * squared;
+                volume[i + j] = 4.0 / 3.0 * M_PI * squared * r[i + j];
+            }
+        }
+        for(; i < end; i++){
+            double squared = r[i] * r[i];
+            area[i] = 4 * M_PI * squared;
+            volume[i] = 4.0 / 3.0 * M_PI * squared * r[i];
+        }
+    }
+
+    public:
+    void add(const circle& c){
+        circleRadii.push_back(c.getRadius());
+        circleSources.push_back(offered++);
+    }
+
+    void add(const Sphere& s){
+        sphereRadii.push_back(s.getRadius());
+        sphereSources.push_back(offered++);
+    }
+
+    // sorts a mixed collection into the per-type arrays, the type check happens once per shape at ingest.
+    // Shapes of other types have no kernel yet: they are skipped, listed in skipped(), and counted in the return value.
+    size_t addAll(const vector<Shape*>& shapes){
+        size_t skippedBefore = skippedShapes.size();
+        for(Shape* shape : shapes){
+            if(auto c = dynamic_cast<circle*>(shape)){
+                add(*c);
+            }else if(auto s = dynamic_cast<Sphere*>(shape)){
+                add(*s);
+            }else{
+                skippedShapes.push_back(offered++);
+            }
+        }
+        return skippedShapes.size() - skippedBefore;
+    }
+
+    size_t circleCount() const { return circleRadii.size(); }
+    size_t sphereCount() const { return sphereRadii.size(); }
+
+    // ingest positions of the i-th circle / sphere result, and of every shape that was skipped
+    size_t circleShape(size_t i) const { return circleSources[i]; }
+    size_t sphereShape(size_t i) const { return sphereSources[i]; }
+    const vector<size_t>& skipped() const { return skippedShapes; }
+
+    // circleAreas[i] belongs to the shape at circleShape(i), sphereAreas[i] and sphereVolumes[i] to sphereShape(i)
+    struct Results{
+        vector<double> circleAreas;
+        vector<double> sphereAreas;
+        vector<double> sphereVolumes;
+    };
+
+    Results compute(WorkerPool& pool = shapePool()) const {
+        Results results;
+        compute(results, pool);
+        return results;
+    }
+
+    // fills results in place, arrays already of the right size are reused without being cleared
+    void compute(Results& results, WorkerPool& pool = shapePool()) const {
+        results.circleAreas.resize(circleRadii.size());
+        results.sphereAreas.resize(sphereRadii.size());
+        results.sphereVolumes.resize(sphereRadii.size());
+
+        pool.run(circleRadii.size(), CHUNK, [&](size_t begin, size_t end){
+            circleKernel(circleRadii.data(), results.circleAreas.data(), begin, end);
+        });
+        pool.run(sphereRadii.size(), CHUNK, [&](size_t begin, size_t end){
+            sphereKernel(sphereRadii.data(), results.sphereAreas.data(), results.sphereVolumes.data(), begin, end);
+        });
+    }
+};
+
+
+// areas of a mixed collection: virtual call per object vs ShapeBatch
+void benchmarkShapeBatch(size_t shapes){
+    vector<unique_ptr<Shape>> owned;
+    vector<Shape*> objects;
+    vector<shape3d*> solids;
+    mt19937 random(9);
+    uniform_real_distribution<double> radius(0.1, 10.0);
+    for(size_t i = 0; i < shapes; i++){
+        if(random() % 2){
+            owned.push_back(make_unique<circle>(radius(random)));
+        }else{
+            auto sphere = make_unique<Sphere>(radius(random));
+            solids.push_back(sphere.get());
+            owned.push_back(move(sphere));
+        }
+        objects.push_back(owned.back().get());
+    }
+
+    // both sides produce the same outputs (every area, every sphere volume) into arrays allocated up front,
+    // so neither the allocation nor the page faults of the output are timed
+    vector<double> areas(objects.size()), volumes(solids.size());
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < objects.size(); i++){
+        areas[i] = objects[i]->area();
+    }
+    for(size_t i = 0; i < solids.size(); i++){
+        volumes[i] = solids[i]->volume();
+    }
+    double objectMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    ShapeBatch batch;
+    size_t skipped = batch.addAll(objects);
+    ShapeBatch::Results results;
+    WorkerPool single(1);
+    batch.compute(results, single);
+    start = chrono::steady_clock::now();
+    batch.compute(results, single);
+    double singleMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    batch.compute(results);
+    double poolMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    double objectTotal = accumulate(areas.begin(), areas.end(), 0.0) + accumulate(volumes.begin(), volumes.end(), 0.0);
+    double batchTotal = accumulate(results.circleAreas.begin(), results.circleAreas.end(), 0.0)
+                      + accumulate(results.sphereAreas.begin(), results.sphereAreas.end(), 0.0)
+                      + accumulate(results.sphereVolumes.begin(), results.sphereVolumes.end(), 0.0);
+    cout<<"Areas and volumes of "<<shapes<<" shapes: virtual calls "<<objectMs<<" ms, batch "<<singleMs<<" ms (1 thread), "
+        <<poolMs<<" ms (all threads) (totals differ by "<<fabs(objectTotal - batchTotal) / objectTotal<<" relative, "
+        <<skipped<<" shapes skipped)"<<endl;
+}
+
+// Spatial index over placed shapes: a uniform grid of cubic cells kept in a hash map.
+// Every shape is listed in each cell its bounding box touches; shapes much larger than a cell go to a
+// separate list that every query scans. Range queries visit only the cells the region touches,
+// nearest queries search rings of cells around the point until nothing closer can remain. The grid keeps
+// the bounds of the cells it has ever used, so a ring search visits only the shell cells inside them:
+// a query far from all shapes starts at the first ring that reaches the data instead of walking the empty space.
+class SpatialGrid{
+    private:
+    struct Item{
+        Locatable* shape;
+        Box box;
+        bool alive;
+        bool oversized;
+    };
+
+    double cellSize;
+    vector<Item> items;
+    vector<uint32_t> freeIds;
+    unordered_map<uint64_t, vector<uint32_t>> cells;
+    vector<uint32_t> oversized;
+    int64_t lo[3] = {0, 0, 0}, hi[3] = {-1, -1, -1}; // occupied cell bounds per axis, empty while lo > hi
+    static constexpr int64_t MAX_SPAN = 4;        // cells per axis before a shape counts as oversized
+    static constexpr int64_t COORD_BIAS = 1 << 20; // cell coordinates are packed as 3 x 21 bits
+
+    int64_t cellOf(double v) const {
+        return static_cast<int64_t>(floor(v / cellSize));
+    }
+
+    static uint64_t key(int64_t x, int64_t y, int64_t z){
+        return (static_cast<uint64_t>(x + COORD_BIAS) << 42) | (static_cast<uint64_t>(y + COORD_BIAS) << 21) | static_cast<uint64_t>(z + COORD_BIAS);
+    }
+
+    bool isOversized(const Box& box) const {
+        return cellOf(box.max.x) - cellOf(box.min.x) >= MAX_SPAN || cellOf(box.max.y) - cellOf(box.min.y) >= MAX_SPAN
+            || cellOf(box.max.z) - cellOf(box.min.z) >= MAX_SPAN;
+    }
+
+    // the cells a shape's box touches, fewer than MAX_SPAN per axis for every shape kept in cells
+    template<typename Visit>
+    void forEachCell(const Box& box, Visit&& visit) const {
+        for(int64_t x = cellOf(box.min.x); x <= cellOf(box.max.x); x++){
+            for(int64_t y = cellOf(box.min.y); y <= cellOf(box.max.y); y++){
+                for(int64_t z = cellOf(box.min.z); z <= cellOf(box.max.z); z++){
+                    visit(x, y, z);
+                }
+            }
+        }
+    }
+
+    // the cells of region inside the occupied bounds, per axis; false when there are none.
+    // The clamp happens before the cast to int64_t, so a region reaching far past the data costs no more than the data
+    bool occupiedCells(const Box& region, int64_t from[3], int64_t to[3]) const {
+        double regionMin[3] = {region.min.x, region.min.y, region.min.z};
+        double regionMax[3] = {region.max.x, region.max.y, region.max.z};
+        for(int axis = 0; axis < 3; axis++){
+            double first = floor(regionMin[axis] / cellSize), last = floor(regionMax[axis] / cellSize);
+            if(lo[axis] > hi[axis] || first > hi[axis] || last < lo[axis] || first > last){
+                return false;
+            }
+            from[axis] = first < lo[axis] ? lo[axis] : static_cast<int64_t>(first);
+            to[axis] = last > hi[axis] ? hi[axis] : static_cast<int64_t>(last);
+        }
+        return true;
+    }
+
+    void extendBounds(const Box& box){
+        int64_t boxLo[3] = {cellOf(box.min.x), cellOf(box.min.y), cellOf(box.min.z)};
+        int64_t boxHi[3] = {cellOf(box.max.x), cellOf(box.max.y), cellOf(box.max.z)};
+        for(int axis = 0; axis < 3; axis++){
+            if(lo[axis] > hi[axis]){
+                lo[axis] = boxLo[axis];
+                hi[axis] = boxHi[axis];
+            }else{
+                lo[axis] = min(lo[axis], boxLo[axis]);
+                hi[axis] = max(hi[axis], boxHi[axis]);
+            }
+        }
+    }
+
+    // visits the cells at Chebyshev distance exactly `ring` from c that lie inside the occupied bounds
+    template<typename Visit>
+    void forEachShellCell(const int64_t c[3], int64_t ring, Visit&& visit) const {
+        int64_t from[3], to[3];
+        for(int axis = 0; axis < 3; axis++){
+            from[axis] = max(lo[axis], c[axis] - ring);
+            to[axis] = min(hi[axis], c[axis] + ring);
+        }
+        for(int64_t x = from[0]; x <= to[0]; x++){
+            bool xFace = llabs(x - c[0]) == ring;
+            for(int64_t y = from[1]; y <= to[1]; y++){
+                if(xFace || llabs(y - c[1]) == ring){
+                    for(int64_t z = from[2]; z <= to[2]; z++){
+                        visit(x, y, z);
+                    }
+                }else{
+                    // inside the x and y faces only the two z faces belong to the shell
+                    if(c[2] - ring >= from[2]){
+                        visit(x, y, c[2] - ring);
+                    }
+                    if(ring > 0 && c[2] + ring <= to[2]){
+                        visit(x, y, c[2] + ring);
+                    }
+                }
+            }
+        }
+    }
+
+    // how many cells forEachShellCell(c, ring) visits
+    uint64_t shellSize(const int64_t c[3], int64_t ring) const {
+        uint64_t outer = 1, inner = 1;
+        for(int axis = 0; axis < 3; axis++){
+            outer *= static_cast<uint64_t>(max<int64_t>(0, min(hi[axis], c[axis] + ring) - max(lo[axis], c[axis] - ring) + 1));
+            inner *= static_cast<uint64_t>(max<int64_t>(0, min(hi[axis], c[axis] + ring - 1) - max(lo[axis], c[axis] - ring + 1) + 1));
+        }
+        return ring == 0 ? outer : outer - inner;
+    }
+
+    // (cell key, item id) pairs for items [begin, end), used by the bulk loader
+    void cellPairs(size_t begin, size_t end, vector<pair<uint64_t, uint32_t>>& out) const {
+        for(size_t id = begin; id < end; id++){
+            if(!items[id].oversized){
+                forEachCell(items[id].box, [&](int64_t x, int64_t y, int64_t z){
+                    out.emplace_back(key(x, y, z), static_cast<uint32_t>(id));
+                });
+            }
+        }
+    }
+
+    public:
+    explicit SpatialGrid(double cellSize): cellSize(cellSize) {}
+
+    // replaces the contents: cell assignment and sorting run on the pool's threads, then cells are filled in one pass
+    void bulkLoad(const vector<Locatable*>& shapes, WorkerPool& pool = shapePool()){
+        items.clear();
+        freeIds.clear();
+        cells.clear();
+        oversized.clear();
+        lo[0] = lo[1] = lo[2] = 0;
+        hi[0] = hi[1] = hi[2] = -1;
+        items.resize(shapes.size());
+
+        size_t parts = pool.threads();
+        size_t per = (shapes.size() + parts - 1) / parts;
+        vector<vector<pair<uint64_t, uint32_t>>> partial(parts);
+        pool.run(parts, 1, [&](size_t first, size_t last){
+            for(size_t t = first; t < last; t++){
+                size_t begin = min(shapes.size(), t * per), end = min(shapes.size(), begin + per);
+                for(size_t id = begin; id < end; id++){
+                    Box box = shapes[id]->bounds();
+                    items[id] = {shapes[id], box, true, isOversized(box)};
+                }
+                partial[t].reserve((end - begin) * 2);
+                cellPairs(begin, end, partial[t]);
+                sort(partial[t].begin(), partial[t].end());
+            }
+        });
+
+        vector<pair<uint64_t, uint32_t>> pairs;
+        for(auto& part : partial){
+            size_t middle = pairs.size();
+            pairs.insert(pairs.end(), part.begin(), part.end());
+            inplace_merge(pairs.begin(), pairs.begin() + middle, pairs.end());
+            vector<pair<uint64_t, uint32_t>>().swap(part);
+        }
+
+        cells.reserve(pairs.size() / 2 + 1);
+        for(size_t i = 0; i < pairs.size();){
+            size_t j = i;
+            while(j < pairs.size() && pairs[j].first == pairs[i].first){
+                j++;
+            }
+            vector<uint32_t>& cell = cells[pairs[i].first];
+            cell.reserve(j - i);
+            for(; i < j; i++){
+                cell.push_back(pairs[i].second);
+            }
+        }
+        for(size_t id = 0; id < items.size(); id++){
+            if(items[id].oversized){
+                oversized.push_back(static_cast<uint32_t>(id));
+            }else{
+                extendBounds(items[id].box);
+            }
+        }
+    }
+
+    // returns a handle for remove()
+    uint32_t insert(Locatable* shape){
+        uint32_t id;
+        Box box = shape->bounds();
+        Item item{shape, box, true, isOversized(box)};
+        if(!freeIds.empty()){
+            id = freeIds.back();
+            freeIds.pop_back();
+            items[id] = item;
+        }else{
+            id = static_cast<uint32_t>(items.size());
+            items.push_back(item);
+        }
+        if(item.oversized){
+            oversized.push_back(id);
+        }else{
+            forEachCell(box, [&](int64_t x, int64_t y, int64_t z){ cells[key(x, y, z)].push_back(id); });
+            extendBounds(box);
+        }
+        return id;
+    }
+
+    void remove(uint32_t id){
+        if(id >= items.size() || !items[id].alive){
+            return;
+        }
+        auto erase = [id](vector<uint32_t>& list){
+            auto it = find(list.begin(), list.end(), id);
+            if(it != list.end()){
+                *it = list.back();
+                list.pop_back();
+            }
+        };
+        if(items[id].oversized){
+            erase(oversized);
+        }else{
+            forEachCell(items[id].box, [&](int64_t x, int64_t y, int64_t z){
+                auto cell = cells.find(key(x, y, z));
+                if(cell != cells.end()){
+                    erase(cell->second);
+                    if(cell->second.empty()){
+                        cells.erase(cell);
+                    }
+                }
+            });
+        }
+        items[id].alive = false;
+        freeIds.push_back(id);
+    }
+
+    // all shapes whose bounds intersect the region; read only, safe to run from many threads at once.
+    // Only the cells inside the occupied bounds are visited, and if those are more than the grid holds a plain
+    // scan over all shapes is cheaper and takes over. Returns false (and finds nothing) for a region with a
+    // NaN or infinite coordinate.
+    bool queryRange(const Box& region, vector<Locatable*>& out) const {
+        for(double v : {region.min.x, region.min.y, region.min.z, region.max.x, region.max.y, region.max.z}){
+            if(!isfinite(v)){
+                return false;
+            }
+        }
+        int64_t from[3], to[3];
+        if(occupiedCells(region, from, to)){
+            uint64_t span = 1;
+            for(int axis = 0; axis < 3; axis++){
+                span *= static_cast<uint64_t>(to[axis] - from[axis] + 1);
+            }
+            if(span > cells.size()){
+                for(const Item& item : items){
+                    if(item.alive && !item.oversized && item.box.intersects(region)){
+                        out.push_back(item.shape);
+                    }
+                }
+            }else{
+                for(int64_t x = from[0]; x <= to[0]; x++){
+                    for(int64_t y = from[1]; y <= to[1]; y++){
+                        for(int64_t z = from[2]; z <= to[2]; z++){
+                            auto cell = cells.find(key(x, y, z));
+                            if(cell == cells.end()){
+                                continue;
+                            }
+                            for(uint32_t id : cell->second){
+                                const Box& box = items[id].box;
+                                // a shape spanning several cells is reported only from the cell holding the
+                                // corner max(shape.min, region.min), so nothing is reported twice; that cell
+                                // lies between the shape's own cells, so the clamp to the bounds never skips it
+                                if(box.intersects(region) && cellOf(max(box.min.x, region.min.x)) == x
+                                   && cellOf(max(box.min.y, region.min.y)) == y && cellOf(max(box.min.z, region.min.z)) == z){
+                                    out.push_back(items[id].shape);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        for(uint32_t id : oversized){
+            if(items[id].box.intersects(region)){
+                out.push_back(items[id].shape);
+            }
+        }
+        return true;
+    }
+
+    // the n shapes closest to p, closest first
+    // Rings stop once the k-th best distance is within the distance from p to everything not yet searched
+    // (the occupied bounds minus the searched cube). If the rings visit more cells than the grid holds
+    // (sparse data spread over wide bounds) a plain scan over all shapes is cheaper and takes over.
+    vector<pair<double, Locatable*>> nearest(const Point& p, size_t n) const {
+        vector<pair<double, uint32_t>> best; // max-heap on distance
+        auto offer = [&](uint32_t id){
+            double distance = items[id].shape->distanceTo(p);
+            if(best.size() < n){
+                best.emplace_back(distance, id);
+                push_heap(best.begin(), best.end());
+            }else if(distance < best.front().first){
+                pop_heap(best.begin(), best.end());
+                best.back() = {distance, id};
+                push_heap(best.begin(), best.end());
+            }
+        };
+        auto consider = [&](uint32_t id){
+            for(const auto& entry : best){
+                if(entry.second == id){
+                    return;
+                }
+            }
+            offer(id);
+        };
+
+        for(uint32_t id : oversized){
+            consider(id);
+        }
+        if(n > 0 && items.size() > freeIds.size() && lo[0] <= hi[0]){
+            int64_t c[3] = {cellOf(p.x), cellOf(p.y), cellOf(p.z)};
+            size_t live = items.size() - freeIds.size();
+            // rings closer than `first` miss the occupied bounds entirely, rings past `last` lie outside them
+            int64_t first = 0, last = 0;
+            for(int axis = 0; axis < 3; axis++){
+                first = max({first, lo[axis] - c[axis], c[axis] - hi[axis]});
+                last = max({last, c[axis] - lo[axis], hi[axis] - c[axis]});
+            }
+            double pos[3] = {p.x, p.y, p.z};
+            // distance from p to the occupied cells outside ring `ring`, infinity when there are none
+            auto beyond = [&](int64_t ring){
+                double closest = numeric_limits<double>::infinity();
+                for(int axis = 0; axis < 3; axis++){
+                    for(int side = -1; side <= 1; side += 2){
+                        // the occupied bounds cut down to the slab past the ring on this side of this axis
+                        double from[3], to[3];
+                        for(int a = 0; a < 3; a++){
+                            from[a] = lo[a] * cellSize;
+                            to[a] = (hi[a] + 1) * cellSize;
+                        }
+                        if(side > 0){
+                            from[axis] = max(from[axis], (c[axis] + ring + 1) * cellSize);
+                        }else{
+                            to[axis] = min(to[axis], (c[axis] - ring) * cellSize);
+                        }
+                        if(from[axis] >= to[axis]){
+                            continue;
+                        }
+                        double squared = 0;
+                        for(int a = 0; a < 3; a++){
+                            double gap = max({0.0, from[a] - pos[a], pos[a] - to[a]});
+                            squared += gap * gap;
+                        }
+                        closest = min(closest, sqrt(squared));
+                    }
+                }
+                return closest;
+            };
+
+            uint64_t visited = 0;
+            bool scan = false;
+            for(int64_t ring = first; ring <= last; ring++){
+                visited += shellSize(c, ring);
+                if(visited > cells.size()){
+                    scan = true;
+                    break;
+                }
+                forEachShellCell(c, ring, [&](int64_t x, int64_t y, int64_t z){
+                    auto cell = cells.find(key(x, y, z));
+                    if(cell != cells.end()){
+                        for(uint32_t id : cell->second){
+                            consider(id);
+                        }
+                    }
+                });
+                bool full = best.size() == n || best.size() == live;
+                if(full && best.front().first <= beyond(ring)){
+                    break;
+                }
+            }
+            if(scan){
+                best.clear();
+                for(size_t id = 0; id < items.size(); id++){
+                    if(items[id].alive){
+                        offer(static_cast<uint32_t>(id));
+                    }
+                }
+            }
+        }
+
+        sort_heap(best.begin(), best.end());
+        vector<pair<double, Locatable*>> result;
+        for(const auto& entry : best){
+            result.emplace_back(entry.first, items[entry.second].shape);
+        }
+        return result;
     }
 };
 
+
+// bulk load with 1 and all threads, then range / nearest query throughput and insert / remove rate
+void benchmarkSpatialGrid(size_t shapes, size_t queries){
+    vector<unique_ptr<Locatable>> owned;
+    vector<Locatable*> placed;
+    mt19937 random(21);
+    uniform_real_distribution<double> coordinate(0.0, 1000.0);
+    uniform_real_distribution<double> radius(0.1, 2.0);
+    for(size_t i = 0; i < shapes; i++){
+        Point center{coordinate(random), coordinate(random), coordinate(random)};
+        if(random() % 2){
+            owned.push_back(make_unique<circle>(radius(random), Point{center.x, center.y, 0}));
+        }else{
+            owned.push_back(make_unique<Sphere>(radius(random), center));
+        }
+        placed.push_back(owned.back().get());
+    }
+
+    SpatialGrid grid(8.0);
+    auto time = [](auto&& body){
+        auto start = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    WorkerPool single(1);
+    double serialLoad = time([&](){ grid.bulkLoad(placed, single); });
+    double parallelLoad = time([&](){ grid.bulkLoad(placed); });
+
+    vector<Box> regions;
+    vector<Point> points;
+    for(size_t q = 0; q < queries; q++){
+        Point corner{coordinate(random), coordinate(random), coordinate(random)};
+        regions.push_back({corner, {corner.x + 20, corner.y + 20, corner.z + 20}});
+        points.push_back({coordinate(random), coordinate(random), coordinate(random)});
+    }
+
+    size_t found = 0;
+    vector<Locatable*> hits;
+    double rangeSeconds = time([&](){
+        for(const auto& region : regions){
+            hits.clear();
+            grid.queryRange(region, hits);
+            found += hits.size();
+        }
+    });
+    double nearestSeconds = time([&](){
+        for(const auto& point : points){
+            found += grid.nearest(point, 10).size();
+        }
+    });
+
+    // spot check both queries against a brute force scan
+    bool correct = true;
+    for(size_t q = 0; q < min<size_t>(queries, 5); q++){
+        hits.clear();
+        grid.queryRange(regions[q], hits);
+        size_t expected = 0;
+        vector<double> distances;
+        for(Locatable* shape : placed){
+            expected += shape->bounds().intersects(regions[q]);
+            distances.push_back(shape->distanceTo(points[q]));
+        }
+        sort(distances.begin(), distances.end());
+        auto near = grid.nearest(points[q], 10);
+        correct &= hits.size() == expected && near.size() == 10 && near.back().first == distances[9];
+    }
+
+    // a point far outside the data: the ring search has to skip the empty space in between
+    Point far{5000, -3000, 4000};
+    vector<pair<double, Locatable*>> farNearest;
+    double farSeconds = time([&](){ farNearest = grid.nearest(far, 10); });
+    vector<double> farDistances;
+    for(Locatable* shape : placed){
+        farDistances.push_back(shape->distanceTo(far));
+    }
+    nth_element(farDistances.begin(), farDistances.begin() + 9, farDistances.end());
+    correct &= farNearest.size() == 10 && farNearest.back().first == farDistances[9];
+
+    // regions reaching far past the data: only the occupied cells are visited (or every shape is scanned)
+    Box everything{{-8000, -8000, -8000}, {8000, 8000, 8000}};
+    Box halfSpace{{-8000, -8000, -8000}, {500, 8000, 8000}};
+    size_t everythingFound = 0, halfFound = 0;
+    double largeSeconds = time([&](){
+        hits.clear();
+        grid.queryRange(everything, hits);
+        everythingFound = hits.size();
+        hits.clear();
+        grid.queryRange(halfSpace, hits);
+        halfFound = hits.size();
+    });
+    size_t halfExpected = 0;
+    for(Locatable* shape : placed){
+        halfExpected += shape->bounds().intersects(halfSpace);
+    }
+    correct &= everythingFound == placed.size() && halfFound == halfExpected;
+    hits.clear();
+    correct &= !grid.queryRange({{0, 0, 0}, {numeric_limits<double>::quiet_NaN(), 10, 10}}, hits) && hits.empty();
+
+    vector<uint32_t> ids;
+    double updateSeconds = time([&](){
+        for(size_t i = 0; i < queries; i++){
+            ids.push_back(grid.insert(placed[i % placed.size()]));
+        }
+        for(uint32_t id : ids){
+            grid.remove(id);
+        }
+    });
+
+    cout<<"Spatial grid over "<<shapes<<" shapes: bulk load "<<serialLoad * 1000<<" ms (1 thread), "
+        <<parallelLoad * 1000<<" ms (all threads); "<<queries / rangeSeconds<<" range queries/s, "
+        <<queries / nearestSeconds<<" nearest-10 queries/s, far-away nearest-10 "<<farSeconds * 1000<<" ms, "
+        <<"two +-8000 range queries "<<largeSeconds * 1000<<" ms, "
+        <<2 * queries / updateSeconds<<" inserts+removes/s, "
+        <<(correct ? "matches brute force" : "MISMATCH vs brute force")<<endl;
+}
+
+
 int main(){
     // Circle uses Shape interface
-    Shape* c = new circle();
+    Shape* c = new circle(2.0);
     Client client(c);
     client.displayArea();
 
     // Sphere uses shape3d interface which extends Shape
-    Shape* s = new Sphere();
+    Shape* s = new Sphere(3.0);
     Client client2(s);
     client2.displayArea();
 
+    benchmarkShapeBatch(4000000);
+    benchmarkSpatialGrid(1000000, 20000);
+
+    delete c;
+    delete s;
     return 0;
-}
\ No newline at end of file
+}
@@ -1,80 +1,164 @@
 #include<iostream>
 #include<bits/stdc++.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#include "../common/WorkerPool.h"
 using namespace std;
 
+// Balance in integer cents behind an atomic, so concurrent deposits and withdrawals never lose an update.
+// Withdrawals use a CAS loop: the check "enough funds?" and the subtraction happen as one step,
+// so no interleaving of threads can take the balance below zero. Deposits and withdrawals refuse
+// negative amounts, so neither can be used to run the other in reverse.
+class AtomicBalance{
+    private:
+        atomic<int64_t> cents;
+
+    public:
+        explicit AtomicBalance(int64_t cents = 0) : cents(cents) {}
+
+        static int64_t toCents(double amount){
+            return llround(amount * 100);
+        }
+
+        static double toAmount(int64_t cents){
+            return cents / 100.0;
+        }
+
+        // amounts coming from callers must be finite, not negative and fit in int64 cents
+        // (toCents of NaN or of a huge value is unspecified)
+        static bool validAmount(double amount){
+            return isfinite(amount) && amount >= 0 && amount <= 1e15;
+        }
+
+        bool add(int64_t amount){
+            if (amount < 0) {
+                return false; // adding a negative amount would be a withdrawal without the funds check
+            }
+            cents.fetch_add(amount, memory_order_relaxed);
+            return true;
+        }
+
+        // signed change with no checks, only for replaying changes that were checked when they first ran
+        void adjust(int64_t amount){
+            cents.fetch_add(amount, memory_order_relaxed);
+        }
+
+        bool trySubtract(int64_t amount){
+            if (amount < 0) {
+                return false; // subtracting a negative amount would be a deposit
+            }
+            int64_t current = cents.load(memory_order_relaxed);
+            do {
+                if (current < amount) {
+                    return false;
+                }
+            } while (!cents.compare_exchange_weak(current, current - amount, memory_order_relaxed));
+            return true;
+        }
+
+        int64_t load() const {
+            return cents.load(memory_order_relaxed);
+        }
+};
+
 // Abstract/ interface class for accounts that do not support withdrawal
 class NoWithdrawableAccount{
     public:
-        virtual void deposit(double amount) = 0;
+        // returns false (and leaves the balance untouched) for negative or non-finite amounts
+        virtual bool deposit(double amount) = 0;
         virtual double getBalance() const = 0;
+        virtual ~NoWithdrawableAccount() = default;
 };
 
 // Abstract/ interface class for accounts that support withdrawal and inherits from NoWithdrawableAccount
 class WithdrawableAccount : public NoWithdrawableAccount{
     public:
-        virtual void withdraw(double amount) = 0;
+        // returns false (and leaves the balance untouched) when the funds are insufficient
+        // or the amount is negative or not finite
+        virtual bool withdraw(double amount) = 0;
 };
 
 // Concrete class for saving account that supports withdrawal
 class SavingAccount: public WithdrawableAccount{
     private:
-        double balance;
+        AtomicBalance balance;
     public:
-        SavingAccount(double initialBalance) : balance(initialBalance) {}
+        SavingAccount(double initialBalance) : balance(AtomicBalance::toCents(initialBalance)) {}
 
-        void deposit(double amount) override {
-            balance += amount;
+        bool deposit(double amount) override {
+            return AtomicBalance::validAmount(amount) && balance.add(AtomicBalance::toCents(amount));
         }
 
         double getBalance() const override {
+            return AtomicBalance::toAmount(balance.load());
+        }
+
+        // direct access for bulk readers (reports, batch jobs) that skip the virtual call
+        const AtomicBalance& balanceCell() const {
             return balance;
         }
 
-        void withdraw(double amount) override {
-            if (amount <= balance) {
-                balance -= amount;
-            } else {
-                cout << "Insufficient funds!" << endl;
-            }
+        AtomicBalance& balanceCell() {
+            return balance;
+        }
+
+        bool withdraw(double amount) override {
+            return AtomicBalance::validAmount(amount) && balance.trySubtract(AtomicBalance::toCents(amount));
         }
 };
 
 // Concrete class for current account that supports withdrawal
 class CurrentAccount: public WithdrawableAccount{
     private:
-        double balance;
+        AtomicBalance balance;
     public:
-        CurrentAccount(double initialBalance) : balance(initialBalance) {}
+        CurrentAccount(double initialBalance) : balance(AtomicBalance::toCents(initialBalance)) {}
 
-        void deposit(double amount) override {
-            balance += amount;
+        bool deposit(double amount) override {
+            return AtomicBalance::validAmount(amount) && balance.add(AtomicBalance::toCents(amount));
         }
 
         double getBalance() const override {
+            return AtomicBalance::toAmount(balance.load());
+        }
+
+        // direct access for bulk readers (reports, batch jobs) that skip the virtual call
+        const AtomicBalance& balanceCell() const {
             return balance;
         }
 
-        void withdraw(double amount) override {
-            if (amount <= balance) {
-                balance -= amount;
-            } else {
-                cout << "Insufficient funds!" << endl;
-            }
+        AtomicBalance& balanceCell() {
+            return balance;
+        }
+
+        bool withdraw(double amount) override {
+            return AtomicBalance::validAmount(amount) && balance.trySubtract(AtomicBalance::toCents(amount));
         }
 };
 
 // Concrete class for fixed deposit account that does not support withdrawal
 class FixedDepositAccount: public NoWithdrawableAccount{
     private:
-        double balance;
+        AtomicBalance balance;
     public:
-        FixedDepositAccount(double initialBalance) : balance(initialBalance) {}
+        FixedDepositAccount(double initialBalance) : balance(AtomicBalance::toCents(initialBalance)) {}
 
-        void deposit(double amount) override {
-            balance += amount;
+        bool deposit(double amount) override {
+            return AtomicBalance::validAmount(amount) && balance.add(AtomicBalance::toCents(amount));
         }
 
         double getBalance() const override {
+            return AtomicBalance::toAmount(balance.load());
+        }
+
+        // direct access for bulk readers (reports, batch jobs) that skip the virtual call
+        const AtomicBalance& balanceCell() const {
+            return balance;
+        }
+
+        AtomicBalance& balanceCell() {
             return balance;
         }
 };
@@ -90,40 +174,1287 @@ class Client{
         // Method to display balances of all accounts without violating LSP
         void displayBalances() const {
             for (const auto& account : noWithdrawableAccount) {
-                cout << "Balance of NoWithdrawableAccount: " << account->getBalance() << endl;
+                cout << "Balance of NoWithdrawableAccount: " << account->getBalance() << '\n';
             }
             for(const auto & account : withdrawableAccounts){
-                cout << "Balance of WithdrawableAccount: " << account->getBalance() << endl;
+                cout << "Balance of WithdrawableAccount: " << account->getBalance() << '\n';
             }
         }
 
         // Methods to perform operations on accounts without violating LSP
         void makeDepositToNoWithdrawableAccounts(double amount) {
             for (auto& account : noWithdrawableAccount) {
-                account->deposit(amount);
-                cout << "Deposited " << amount << " to NoWithdrawableAccount. New Balance: " << account->getBalance() << endl;
+                if (!account->deposit(amount)) {
+                    cout << "Invalid amount!" << '\n';
+                }
+                cout << "Deposited " << amount << " to NoWithdrawableAccount. New Balance: " << account->getBalance() << '\n';
             }
         }
 
         // Methods to perform operations on accounts without violating LSP
         void makeDepositToWithdrawableAccounts(double amount) {
             for (auto& account : withdrawableAccounts) {
-                account->deposit(amount);
-                cout << "Deposited " << amount << " to WithdrawableAccount. New Balance: " << account->getBalance() << endl;    
+                if (!account->deposit(amount)) {
+                    cout << "Invalid amount!" << '\n';
+                }
+                cout << "Deposited " << amount << " to WithdrawableAccount. New Balance: " << account->getBalance() << '\n';    
             }
         }
 
         // Methods to perform operations on accounts without violating LSP
         void makeWithdrawal(double amount) {
             for (auto& account : withdrawableAccounts) {
-                account->withdraw(amount);
-                cout << "Withdrew " << amount << " from WithdrawableAccount. New Balance: " << account->getBalance() << endl;
+                if (!account->withdraw(amount)) {
+                    cout << "Insufficient funds!" << '\n';
+                }
+                cout << "Withdrew " << amount << " from WithdrawableAccount. New Balance: " << account->getBalance() << '\n';
+            }
+        }
+
+};
+
+
+enum class AccountType { Saving, Current, FixedDeposit };
+
+// Account table shared by many threads.
+// Accounts are spread over shards, each with its own lock, and the lock only guards the table itself:
+// once an account is found the balance update is a plain atomic operation on the account.
+// Accounts are never removed, so a pointer found under the shard lock stays valid afterwards.
+// A transfer is a debit followed by a credit. Transfers hold transferGate shared while they run and the
+// whole-ledger readers (exportBalances, forEach) hold it exclusively, so those readers never see money
+// that has left one account but not yet reached the other. Single-account reads (getBalance) and plain
+// deposits / withdrawals do not take the gate; each of those is one atomic step on its own.
+class Ledger{
+    private:
+        struct Entry{
+            unique_ptr<NoWithdrawableAccount> account;
+            WithdrawableAccount* withdrawable; // null for accounts that do not support withdrawal
+            AtomicBalance* balance;            // used by bulk exports / batch jobs without going through the vtable
+            AccountType type;
+            mutable mutex transferLock; // taken only by transfers, always in ascending id order
+
+            Entry(unique_ptr<NoWithdrawableAccount> account, WithdrawableAccount* withdrawable, AtomicBalance* balance, AccountType type)
+                : account(move(account)), withdrawable(withdrawable), balance(balance), type(type) {}
+        };
+
+        struct alignas(64) Shard{
+            mutable shared_mutex lock;
+            deque<Entry> entries; // deque keeps entries in place while new accounts are appended
+        };
+
+        static constexpr uint64_t SHARDS = 64;
+        array<Shard, SHARDS> shards;
+        atomic<uint64_t> nextShard{0};
+        mutable shared_mutex transferGate;
+
+        // id = local index * SHARDS + shard
+        const Entry* find(uint64_t id) const {
+            const Shard& shard = shards[id % SHARDS];
+            shared_lock<shared_mutex> guard(shard.lock);
+            uint64_t index = id / SHARDS;
+            return index < shard.entries.size() ? &shard.entries[index] : nullptr;
+        }
+
+        static bool applyTransfer(const Entry& source, const Entry& target, double amount){
+            if (!source.withdrawable->withdraw(amount)) {
+                return false;
+            }
+            target.account->deposit(amount);
+            return true;
+        }
+
+    public:
+        uint64_t open(AccountType type, double initialBalance){
+            unique_ptr<NoWithdrawableAccount> account;
+            WithdrawableAccount* withdrawable = nullptr;
+            AtomicBalance* balance = nullptr;
+            if (type == AccountType::FixedDeposit) {
+                auto fixedDeposit = make_unique<FixedDepositAccount>(initialBalance);
+                balance = &fixedDeposit->balanceCell();
+                account = move(fixedDeposit);
+            } else if (type == AccountType::Saving) {
+                auto saving = new SavingAccount(initialBalance);
+                balance = &saving->balanceCell();
+                withdrawable = saving;
+            } else {
+                auto current = new CurrentAccount(initialBalance);
+                balance = &current->balanceCell();
+                withdrawable = current;
+            }
+            if (withdrawable) {
+                account.reset(withdrawable);
+            }
+
+            uint64_t shardIndex = nextShard.fetch_add(1, memory_order_relaxed) % SHARDS;
+            Shard& shard = shards[shardIndex];
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.entries.emplace_back(move(account), withdrawable, balance, type);
+            return (shard.entries.size() - 1) * SHARDS + shardIndex;
+        }
+
+        // false for unknown ids and negative / non-finite amounts
+        bool deposit(uint64_t id, double amount){
+            const Entry* entry = find(id);
+            return entry && entry->account->deposit(amount);
+        }
+
+        // false for unknown ids, negative / non-finite amounts, accounts without withdrawal and insufficient funds
+        bool withdraw(uint64_t id, double amount){
+            const Entry* entry = find(id);
+            return entry && entry->withdrawable && entry->withdrawable->withdraw(amount);
+        }
+
+        // adds (or with a negative amount takes) cents with no checks at all; only for journal replay,
+        // which re-applies operations that already passed every check when they first ran
+        bool applyUnchecked(uint64_t id, int64_t cents){
+            const Entry* entry = find(id);
+            if (!entry) {
+                return false;
+            }
+            entry->balance->adjust(cents);
+            return true;
+        }
+
+        // Moves money from a withdrawable account to any account as one step.
+        // Both transfer locks are taken in ascending id order, so two transfers in opposite
+        // directions can never wait on each other; the balances themselves are still atomics,
+        // so plain deposits/withdrawals running at the same time are never lost either.
+        bool transfer(uint64_t from, uint64_t to, double amount){
+            const Entry* source = find(from);
+            const Entry* target = find(to);
+            if (!source || !target || !source->withdrawable || !AtomicBalance::validAmount(amount)) {
+                return false;
+            }
+            if (source == target) {
+                return true;
+            }
+            shared_lock<shared_mutex> gate(transferGate);
+            const Entry* first = from < to ? source : target;
+            const Entry* second = from < to ? target : source;
+            scoped_lock guard(first->transferLock, second->transferLock);
+            return applyTransfer(*source, *target, amount);
+        }
+
+        struct Transfer{
+            uint64_t from;
+            uint64_t to;
+            double amount;
+        };
+
+        // Group commit: every account touched by the batch is locked once (ascending id order),
+        // then all transfers are applied in order. Each endpoint is resolved once and the scratch
+        // vectors are reused per thread, so the only extra work over single transfers is sorting
+        // the batch's accounts. That pays off when threads fight over a few hot accounts; with
+        // little contention single transfer() calls are as fast or faster.
+        vector<bool> transferBatch(const vector<Transfer>& transfers){
+            vector<bool> applied(transfers.size(), false);
+            thread_local vector<pair<const Entry*, const Entry*>> resolved;
+            thread_local vector<pair<uint64_t, const Entry*>> involved;
+            resolved.clear();
+            involved.clear();
+            for (const auto& transfer : transfers) {
+                const Entry* source = find(transfer.from);
+                const Entry* target = find(transfer.to);
+                resolved.emplace_back(source, target);
+                if (source && target) {
+                    involved.emplace_back(transfer.from, source);
+                    involved.emplace_back(transfer.to, target);
+                }
+            }
+            sort(involved.begin(), involved.end());
+            involved.erase(unique(involved.begin(), involved.end()), involved.end());
+
+            shared_lock<shared_mutex> gate(transferGate);
+            for (const auto& locked : involved) {
+                locked.second->transferLock.lock();
+            }
+            for (size_t i = 0; i < transfers.size(); i++) {
+                auto [source, target] = resolved[i];
+                if (source && target && source->withdrawable && AtomicBalance::validAmount(transfers[i].amount)) {
+                    applied[i] = source == target || applyTransfer(*source, *target, transfers[i].amount);
+                }
+            }
+            for (auto it = involved.rbegin(); it != involved.rend(); ++it) {
+                it->second->transferLock.unlock();
+            }
+            return applied;
+        }
+
+        optional<double> getBalance(uint64_t id) const {
+            const Entry* entry = find(id);
+            if (!entry) {
+                return nullopt;
+            }
+            return entry->account->getBalance();
+        }
+
+        size_t size() const {
+            size_t count = 0;
+            for (const auto& shard : shards) {
+                shared_lock<shared_mutex> guard(shard.lock);
+                count += shard.entries.size();
+            }
+            return count;
+        }
+
+        // balances of every account copied into columns, read straight from the atomics;
+        // no transfer is half applied in the copy
+        template<typename Columns>
+        void exportBalances(Columns& columns) const {
+            unique_lock<shared_mutex> gate(transferGate);
+            columns.clear();
+            columns.reserve(size());
+            for (uint64_t s = 0; s < SHARDS; s++) {
+                shared_lock<shared_mutex> guard(shards[s].lock);
+                for (size_t i = 0; i < shards[s].entries.size(); i++) {
+                    const Entry& entry = shards[s].entries[i];
+                    columns.add(i * SHARDS + s, entry.type, entry.balance->load());
+                }
+            }
+        }
+
+        // ids and balance cells of every account of one type, for batch jobs that work type by type.
+        // The cells are written directly, so a JournaledLedger runs such jobs through runBatchJob().
+        void balanceCells(AccountType type, vector<uint64_t>& ids, vector<AtomicBalance*>& cells){
+            ids.clear();
+            cells.clear();
+            for (uint64_t s = 0; s < SHARDS; s++) {
+                shared_lock<shared_mutex> guard(shards[s].lock);
+                for (size_t i = 0; i < shards[s].entries.size(); i++) {
+                    if (shards[s].entries[i].type == type) {
+                        ids.push_back(i * SHARDS + s);
+                        cells.push_back(shards[s].entries[i].balance);
+                    }
+                }
+            }
+        }
+
+        // visits every account, shard by shard, with transfers paused (the visitor must not transfer)
+        template<typename Visitor>
+        void forEach(Visitor&& visit) const {
+            unique_lock<shared_mutex> gate(transferGate);
+            for (uint64_t s = 0; s < SHARDS; s++) {
+                shared_lock<shared_mutex> guard(shards[s].lock);
+                for (size_t i = 0; i < shards[s].entries.size(); i++) {
+                    const Entry& entry = shards[s].entries[i];
+                    visit(i * SHARDS + s, entry.type, *entry.account);
+                }
+            }
+        }
+};
+
+
+// many threads hammering a shared ledger with random deposits and withdrawals,
+// afterwards the books must balance and no account may be negative
+void benchmarkLedgerContention(size_t accounts, unsigned threads, size_t opsPerThread){
+    Ledger ledger;
+    vector<uint64_t> ids;
+    for (size_t i = 0; i < accounts; i++) {
+        AccountType type = i % 3 == 0 ? AccountType::FixedDeposit : i % 3 == 1 ? AccountType::Saving : AccountType::Current;
+        ids.push_back(ledger.open(type, 100.0));
+    }
+
+    atomic<int64_t> netCents{0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t](){
+            mt19937_64 random(t + 1);
+            int64_t net = 0;
+            for (size_t op = 0; op < opsPerThread; op++) {
+                uint64_t id = ids[random() % ids.size()];
+                int64_t cents = static_cast<int64_t>(random() % 5000);
+                if (random() & 1) {
+                    ledger.deposit(id, AtomicBalance::toAmount(cents));
+                    net += cents;
+                } else if (ledger.withdraw(id, AtomicBalance::toAmount(cents))) {
+                    net -= cents;
+                }
+            }
+            netCents += net;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int64_t totalCents = 0;
+    bool negative = false;
+    ledger.forEach([&](uint64_t, AccountType, const NoWithdrawableAccount& account){
+        int64_t cents = AtomicBalance::toCents(account.getBalance());
+        totalCents += cents;
+        negative |= cents < 0;
+    });
+    bool balanced = totalCents == static_cast<int64_t>(accounts) * 10000 + netCents.load();
+
+    cout << "Ledger: " << threads * opsPerThread / seconds << " ops/s over " << accounts << " accounts, "
+         << threads << " threads, books " << (balanced && !negative ? "balanced" : "NOT balanced") << endl;
+}
+
+
+// transfers under a skewed workload: most transfers touch one of a few hot accounts,
+// run with growing thread counts, single transfers vs group-committed batches
+void benchmarkTransfers(size_t accounts, size_t hotAccounts, size_t transfersPerThread){
+    for (size_t batchSize : {size_t(1), size_t(64)}) {
+        for (unsigned threads = 1; threads <= max(4u, thread::hardware_concurrency()); threads *= 2) {
+            Ledger ledger;
+            vector<uint64_t> ids;
+            for (size_t i = 0; i < accounts; i++) {
+                ids.push_back(ledger.open(i % 2 ? AccountType::Saving : AccountType::Current, 1000.0));
+            }
+
+            auto start = chrono::steady_clock::now();
+            vector<thread> workers;
+            for (unsigned t = 0; t < threads; t++) {
+                workers.emplace_back([&, t](){
+                    mt19937_64 random(t + 7);
+                    auto pick = [&](){
+                        // 90% of the endpoints are hot accounts
+                        return ids[random() % 10 < 9 ? random() % hotAccounts : random() % ids.size()];
+                    };
+                    vector<Ledger::Transfer> batch;
+                    for (size_t i = 0; i < transfersPerThread; i++) {
+                        batch.push_back({pick(), pick(), static_cast<double>(random() % 100)});
+                        if (batch.size() == batchSize) {
+                            if (batchSize == 1) {
+                                ledger.transfer(batch[0].from, batch[0].to, batch[0].amount);
+                            } else {
+                                ledger.transferBatch(batch);
+                            }
+                            batch.clear();
+                        }
+                    }
+                    ledger.transferBatch(batch);
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            double total = 0;
+            ledger.forEach([&](uint64_t, AccountType, const NoWithdrawableAccount& account){
+                total += account.getBalance();
+            });
+            bool conserved = llround(total) == static_cast<long long>(accounts * 1000);
+            cout << "Transfers (batch " << batchSize << ", " << threads << " threads): "
+                 << threads * transfersPerThread / seconds << " transfers/s, money "
+                 << (conserved ? "conserved" : "NOT conserved") << endl;
+        }
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// Durable journal.
+// Every successful open / deposit / withdraw / transfer is appended to an append-only file of fixed size,
+// checksummed records. Concurrent writers share fdatasync calls (group commit): whoever finds no flush in
+// progress writes everything queued so far, the others just wait for it.
+// A snapshot stores all balances together with the last journal sequence it covers, so recovery loads the
+// snapshot and replays only the journal tail after it, reading the journal through mmap. After every
+// snapshot the journal is compacted down to the records the snapshot does not cover, so neither the file
+// nor the restart time grows with the ledger's whole history.
+// ---------------------------------------------------------------------------
+
+enum class JournalOp : uint32_t { Open, Deposit, Withdraw, Transfer };
+
+struct JournalRecord{
+    uint64_t sequence;
+    uint64_t account;
+    uint64_t target;   // transfer destination, account type for Open
+    int64_t cents;
+    uint32_t op;
+    uint32_t checksum;
+};
+static_assert(sizeof(JournalRecord) == 40, "journal records are fixed size, record n lives at offset n * 40");
+
+uint32_t journalChecksum(const void* data, size_t length){
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t journalChecksum(const JournalRecord& record){
+    return journalChecksum(&record, offsetof(JournalRecord, checksum));
+}
+
+// makes a rename inside the directory of `path` durable
+void syncDirectory(const string& path){
+    string directory = filesystem::path(path).parent_path().string();
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+bool writeAll(int fd, const void* data, size_t length){
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t written = ::write(fd, bytes, length);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Append-only journal file holding the records from sequence `base` on.
+// A failed open, write or sync marks the journal failed: from then on nothing is appended and nothing
+// more is reported durable, so a caller is never told a record is on disk when it is not, and no
+// acknowledged record can sit behind a hole in the file.
+class Journal{
+    private:
+        string path;
+        int fd;
+        bool syncOnCommit;
+
+        mutex lock;
+        condition_variable flushed;
+        vector<JournalRecord> pending;
+        vector<JournalRecord> writing;
+        uint64_t base;         // sequence of the first record in the file
+        uint64_t nextSequence;
+        uint64_t durableCount; // every sequence below this is on disk
+        bool flushing = false; // a write or a compaction owns the file
+        bool failed = false;
+
+    public:
+        // the file holds the records base .. base + keepRecords - 1 and is cut back to them,
+        // dropping a torn tail left by a crash
+        Journal(const string& path, uint64_t base, uint64_t keepRecords, bool syncOnCommit)
+            : path(path), fd(::open(path.c_str(), O_RDWR | O_CREAT, 0644)), syncOnCommit(syncOnCommit),
+              base(base), nextSequence(base + keepRecords), durableCount(base + keepRecords) {
+            if (fd < 0) {
+                perror("journal open");
+                failed = true;
+                return;
+            }
+            if (ftruncate(fd, static_cast<off_t>(keepRecords * sizeof(JournalRecord))) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+                perror("journal truncate");
+                failed = true;
+            }
+        }
+
+        ~Journal(){
+            waitDurable(lastSequence());
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        bool healthy(){
+            lock_guard<mutex> guard(lock);
+            return !failed;
+        }
+
+        // queues the record and returns its sequence, waitDurable() makes it durable; nullopt once the journal failed
+        optional<uint64_t> append(JournalRecord record){
+            lock_guard<mutex> guard(lock);
+            if (failed) {
+                return nullopt;
+            }
+            record.sequence = nextSequence++;
+            record.checksum = journalChecksum(record);
+            pending.push_back(record);
+            return record.sequence;
+        }
+
+        // true once every record up to `sequence` is completely written (and synced when syncOnCommit),
+        // false if the journal failed before that
+        bool waitDurable(uint64_t sequence){
+            unique_lock<mutex> guard(lock);
+            while (!failed && durableCount <= sequence && durableCount < nextSequence) {
+                if (flushing) {
+                    flushed.wait(guard);
+                    continue;
+                }
+                flushing = true;
+                writing.swap(pending);
+                uint64_t upTo = nextSequence;
+                guard.unlock();
+
+                bool written = writeAll(fd, writing.data(), writing.size() * sizeof(JournalRecord))
+                            && (!syncOnCommit || fdatasync(fd) == 0);
+                if (!written) {
+                    perror("journal write");
+                }
+                writing.clear();
+
+                guard.lock();
+                if (written) {
+                    durableCount = upTo;
+                } else {
+                    failed = true;
+                }
+                flushing = false;
+                flushed.notify_all();
+            }
+            return !failed || durableCount > sequence;
+        }
+
+        // sequence of the last appended record, base - 1 when nothing was appended since base
+        uint64_t lastSequence(){
+            lock_guard<mutex> guard(lock);
+            return nextSequence - 1;
+        }
+
+        // Drops the records before keepFrom (already covered by a durable snapshot): the records still
+        // needed are copied to a new file that is renamed over the journal. Writers wait while the file
+        // is swapped; if anything goes wrong the old file simply stays in use.
+        bool compact(uint64_t keepFrom){
+            unique_lock<mutex> guard(lock);
+            flushed.wait(guard, [&](){ return !flushing; });
+            keepFrom = min(keepFrom, durableCount);
+            if (failed || keepFrom <= base) {
+                return !failed;
+            }
+            flushing = true;
+            uint64_t oldBase = base;
+            uint64_t end = durableCount;
+            guard.unlock();
+
+            string temporary = path + ".tmp";
+            vector<JournalRecord> kept(end - keepFrom);
+            size_t bytes = kept.size() * sizeof(JournalRecord);
+            int newFd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            bool compacted = newFd >= 0
+                && pread(fd, kept.data(), bytes, static_cast<off_t>((keepFrom - oldBase) * sizeof(JournalRecord))) == static_cast<ssize_t>(bytes)
+                && writeAll(newFd, kept.data(), bytes) && fdatasync(newFd) == 0
+                && rename(temporary.c_str(), path.c_str()) == 0;
+            if (compacted) {
+                syncDirectory(path);
+            } else {
+                perror("journal compact");
+                if (newFd >= 0) {
+                    ::close(newFd);
+                }
+                unlink(temporary.c_str());
+            }
+
+            guard.lock();
+            if (compacted) {
+                ::close(fd);
+                fd = newFd;
+                base = keepFrom;
+            }
+            flushing = false;
+            flushed.notify_all();
+            return compacted;
+        }
+};
+
+// Read-only view of a journal file through mmap. The file starts at sequence base() (older records were
+// compacted away). Only records from `from` on are validated, up to the first one that fails its checksum
+// or breaks the sequence, so the cost follows the tail that is replayed, not the journal's whole history.
+class JournalReader{
+    private:
+        int fd = -1;
+        const JournalRecord* records = nullptr;
+        size_t mappedBytes = 0;
+        uint64_t first = 0;
+        uint64_t end = 0;
+
+    public:
+        JournalReader(const string& path, uint64_t from) : first(from), end(from) {
+            fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(JournalRecord))) {
+                return;
+            }
+            mappedBytes = static_cast<size_t>(info.st_size);
+            void* mapped = mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                mappedBytes = 0;
+                return;
+            }
+            records = static_cast<const JournalRecord*>(mapped);
+            if (records[0].checksum != journalChecksum(records[0])) {
+                return; // not even the first record is intact, treat the file as empty
+            }
+
+            first = records[0].sequence;
+            uint64_t available = mappedBytes / sizeof(JournalRecord);
+            if (from < first || from - first >= available) {
+                end = max(from, first);
+                return;
+            }
+            uint64_t index = from - first;
+            madvise(const_cast<JournalRecord*>(records + index), (available - index) * sizeof(JournalRecord), MADV_SEQUENTIAL);
+            while (index < available && records[index].sequence == first + index && records[index].checksum == journalChecksum(records[index])) {
+                index++;
+            }
+            end = first + index;
+        }
+
+        ~JournalReader(){
+            if (records) {
+                munmap(const_cast<JournalRecord*>(records), mappedBytes);
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        uint64_t base() const { return first; }              // sequence of the first record in the file
+        uint64_t endSequence() const { return end; }         // one past the last valid record
+        const JournalRecord& operator[](uint64_t sequence) const { return records[sequence - first]; }
+};
+
+
+// Ledger whose every change is journaled before the call returns.
+// The constructor is the recovery path: snapshot first, then the journal tail.
+// If the journal fails (disk full, I/O error) the ledger stops accepting changes and every call returns
+// false. The call that ran into the failure may already be applied in memory, so after a failure the
+// in-memory balances can be ahead of the disk; a restart recovers the durable state.
+class JournaledLedger{
+    private:
+        struct SnapshotEntry{
+            uint64_t id;
+            uint64_t type;
+            int64_t cents;
+        };
+
+        Ledger ledger;
+        string snapshotPath;
+        uint64_t snapshotEvery;
+        uint64_t replayed = 0;
+        unique_ptr<Journal> journal;
+
+        // operations hold it shared while they apply + append, a snapshot holds it exclusively,
+        // so a snapshot contains exactly the records up to its sequence
+        shared_mutex checkpointLock;
+        mutex openLock;       // opens are serialized so account ids replay in the same order
+        mutex snapshotLock;
+        atomic<uint64_t> snapshotSequence{0};
+
+        static constexpr uint64_t SNAPSHOT_MAGIC = 0x31504e534c474c; // "LGLSNP1"
+
+        void replayOpen(uint64_t id, AccountType type, int64_t cents){
+            uint64_t restored = ledger.open(type, AtomicBalance::toAmount(cents));
+            if (restored != id) {
+                cerr << "journal replay: account " << id << " restored as " << restored << endl;
+            }
+        }
+
+        // journal records are only written for operations that succeeded, so replay applies them unchecked
+        void replay(const JournalRecord& record){
+            switch (static_cast<JournalOp>(record.op)) {
+                case JournalOp::Open:
+                    replayOpen(record.account, static_cast<AccountType>(record.target), record.cents);
+                    break;
+                case JournalOp::Deposit:
+                    ledger.applyUnchecked(record.account, record.cents);
+                    break;
+                case JournalOp::Withdraw:
+                    ledger.applyUnchecked(record.account, -record.cents);
+                    break;
+                case JournalOp::Transfer:
+                    ledger.applyUnchecked(record.account, -record.cents);
+                    ledger.applyUnchecked(record.target, record.cents);
+                    break;
+            }
+        }
+
+        // returns the first journal sequence not covered by the snapshot
+        uint64_t loadSnapshot(){
+            ifstream in(snapshotPath, ios::binary);
+            uint64_t header[3]; // magic, next sequence, account count
+            if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != SNAPSHOT_MAGIC) {
+                return 0;
+            }
+            vector<SnapshotEntry> entries(header[2]);
+            uint32_t checksum = 0;
+            in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(SnapshotEntry));
+            in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+            if (!in || checksum != journalChecksum(entries.data(), entries.size() * sizeof(SnapshotEntry))) {
+                cerr << "snapshot " << snapshotPath << " is damaged, replaying the full journal" << endl;
+                return 0;
+            }
+            for (const auto& entry : entries) {
+                replayOpen(entry.id, static_cast<AccountType>(entry.type), entry.cents);
+            }
+            return header[1];
+        }
+
+        // apply() runs the operation and may fill in the record (e.g. the id of a new account)
+        // true only once the record is durable
+        template<typename Apply>
+        bool journaled(JournalRecord record, Apply&& apply){
+            optional<uint64_t> sequence;
+            {
+                shared_lock<shared_mutex> guard(checkpointLock);
+                if (!journal->healthy() || !apply(record)) {
+                    return false;
+                }
+                sequence = journal->append(record);
+            }
+            if (!sequence || !journal->waitDurable(*sequence)) {
+                return false;
+            }
+            // a concurrent checkpoint may already cover this record
+            uint64_t covered = snapshotSequence.load(memory_order_relaxed);
+            if (*sequence >= covered && *sequence - covered >= snapshotEvery) {
+                unique_lock<mutex> guard(snapshotLock, try_to_lock);
+                if (guard.owns_lock()) {
+                    checkpointLocked();
+                }
+            }
+            return true;
+        }
+
+        // balances of every account plus the journal position they cover, checkpointLock must be held exclusively
+        uint64_t collectSnapshot(vector<SnapshotEntry>& entries){
+            ledger.forEach([&](uint64_t id, AccountType type, const NoWithdrawableAccount& account){
+                entries.push_back({id, static_cast<uint64_t>(type), AtomicBalance::toCents(account.getBalance())});
+            });
+            return journal->lastSequence() + 1;
+        }
+
+        // Atomically replaces the old snapshot, then compacts the journal down to the records after `next`.
+        // snapshotLock must be held: snapshot writers run one at a time, so the file and snapshotSequence
+        // only ever move forward and the journal is never compacted past the snapshot on disk.
+        // A snapshot at the current position is only rewritten when `changed` (a batch job moved balances
+        // without journal records).
+        bool writeSnapshot(vector<SnapshotEntry>& entries, uint64_t next, bool changed){
+            uint64_t current = snapshotSequence.load();
+            if (next < current || (next == current && !changed)) {
+                return true;
+            }
+            // the snapshot may only point past records that are really on disk
+            if (!journal->waitDurable(next - 1)) {
+                return false;
+            }
+            sort(entries.begin(), entries.end(), [](const SnapshotEntry& a, const SnapshotEntry& b){ return a.id < b.id; });
+            string temporary = snapshotPath + ".tmp";
+            {
+                ofstream out(temporary, ios::binary | ios::trunc);
+                uint64_t header[3] = {SNAPSHOT_MAGIC, next, entries.size()};
+                uint32_t checksum = journalChecksum(entries.data(), entries.size() * sizeof(SnapshotEntry));
+                out.write(reinterpret_cast<const char*>(header), sizeof(header));
+                out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SnapshotEntry));
+                out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+                out.flush();
+                if (!out) {
+                    cerr << "snapshot " << temporary << " could not be written" << endl;
+                    return false;
+                }
+            }
+            int fd = ::open(temporary.c_str(), O_RDONLY);
+            bool synced = fd >= 0 && fsync(fd) == 0;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            if (!synced || rename(temporary.c_str(), snapshotPath.c_str()) != 0) {
+                cerr << "snapshot " << snapshotPath << " could not be replaced" << endl;
+                return false;
+            }
+            syncDirectory(snapshotPath);
+            snapshotSequence = next;
+            // only once the snapshot is durable may the journal forget what it covers
+            journal->compact(next);
+            return true;
+        }
+
+        // snapshotLock must be held
+        bool checkpointLocked(){
+            vector<SnapshotEntry> entries;
+            uint64_t next;
+            {
+                unique_lock<shared_mutex> guard(checkpointLock);
+                next = collectSnapshot(entries);
+            }
+            return writeSnapshot(entries, next, false);
+        }
+
+    public:
+        JournaledLedger(const string& journalPath, const string& snapshotPath, bool syncOnCommit = true, uint64_t snapshotEvery = 1 << 20)
+            : snapshotPath(snapshotPath), snapshotEvery(snapshotEvery) {
+            uint64_t first = loadSnapshot();
+            uint64_t base = first, keep = 0; // by default a fresh journal starts where the snapshot ends
+            {
+                JournalReader reader(journalPath, first);
+                if (reader.base() > first) {
+                    // records between the snapshot and the journal are gone, keep the file for inspection
+                    cerr << "journal starts at " << reader.base() << " but the snapshot ends at " << first
+                         << ", moving it aside and starting a new journal" << endl;
+                    rename(journalPath.c_str(), (journalPath + ".orphaned").c_str());
+                } else if (reader.endSequence() > first) {
+                    for (uint64_t sequence = first; sequence < reader.endSequence(); sequence++) {
+                        replay(reader[sequence]);
+                    }
+                    replayed = reader.endSequence() - first;
+                    base = reader.base();
+                    keep = reader.endSequence() - reader.base();
+                }
             }
+            snapshotSequence = first;
+            journal = make_unique<Journal>(journalPath, base, keep, syncOnCommit);
+        }
+
+        // nullopt when the account could not be made durable
+        optional<uint64_t> open(AccountType type, double initialBalance){
+            lock_guard<mutex> order(openLock);
+            uint64_t id = 0;
+            if (!journaled(JournalRecord{0, 0, static_cast<uint64_t>(type), AtomicBalance::toCents(initialBalance), static_cast<uint32_t>(JournalOp::Open), 0},
+                           [&](JournalRecord& record){ id = record.account = ledger.open(type, initialBalance); return true; })) {
+                return nullopt;
+            }
+            return id;
+        }
+
+        bool deposit(uint64_t id, double amount){
+            return journaled(JournalRecord{0, id, 0, AtomicBalance::toCents(amount), static_cast<uint32_t>(JournalOp::Deposit), 0},
+                             [&](JournalRecord&){ return ledger.deposit(id, amount); });
         }
 
+        bool withdraw(uint64_t id, double amount){
+            return journaled(JournalRecord{0, id, 0, AtomicBalance::toCents(amount), static_cast<uint32_t>(JournalOp::Withdraw), 0},
+                             [&](JournalRecord&){ return ledger.withdraw(id, amount); });
+        }
+
+        bool transfer(uint64_t from, uint64_t to, double amount){
+            return journaled(JournalRecord{0, from, to, AtomicBalance::toCents(amount), static_cast<uint32_t>(JournalOp::Transfer), 0},
+                             [&](JournalRecord&){ return ledger.transfer(from, to, amount); });
+        }
+
+        // writes all balances plus the journal position they cover, waiting for a snapshot already being written
+        bool checkpoint(){
+            lock_guard<mutex> guard(snapshotLock);
+            return checkpointLocked();
+        }
+
+        // Runs a job that changes balances without journal records (e.g. InterestAccrualEngine) and makes
+        // its result durable through a snapshot. Other changes wait until the snapshot is written, so
+        // nothing acknowledged afterwards can be replayed on top of balances from before the job.
+        // Returns false if the snapshot failed: the job's effect is then in memory only.
+        template<typename Job>
+        bool runBatchJob(Job&& job){
+            lock_guard<mutex> snapshotting(snapshotLock); // an older snapshot still being written must not land after ours
+            unique_lock<shared_mutex> guard(checkpointLock);
+            job(ledger);
+            vector<SnapshotEntry> entries;
+            uint64_t next = collectSnapshot(entries);
+            return writeSnapshot(entries, next, true);
+        }
+
+        bool healthy(){ return journal->healthy(); }
+
+        const Ledger& getLedger() const { return ledger; }
+        uint64_t replayedRecords() const { return replayed; }
 };
 
 
+// fills a journal from several threads, then times a restart (snapshot load + tail replay)
+void benchmarkJournalRecovery(size_t accounts, size_t entries, unsigned threads){
+    const string journalPath = "ledger.journal";
+    const string snapshotPath = "ledger.snapshot";
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+
+    double expected = 0;
+    {
+        // no fdatasync while generating, the benchmark is about the restart
+        JournaledLedger ledger(journalPath, snapshotPath, false, entries / 2);
+        vector<uint64_t> ids;
+        for (size_t i = 0; i < accounts; i++) {
+            ids.push_back(ledger.open(i % 3 == 0 ? AccountType::FixedDeposit : AccountType::Saving, 500.0).value());
+        }
+        vector<thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t](){
+                mt19937_64 random(t + 11);
+                for (size_t i = t; i < entries; i += threads) {
+                    uint64_t id = ids[random() % ids.size()];
+                    double amount = static_cast<double>(random() % 10000) / 100;
+                    switch (random() % 3) {
+                        case 0: ledger.deposit(id, amount); break;
+                        case 1: ledger.withdraw(id, amount); break;
+                        default: ledger.transfer(id, ids[random() % ids.size()], amount); break;
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        ledger.getLedger().forEach([&](uint64_t, AccountType, const NoWithdrawableAccount& account){
+            expected += account.getBalance();
+        });
+    }
+
+    auto start = chrono::steady_clock::now();
+    JournaledLedger recovered(journalPath, snapshotPath);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double total = 0;
+    recovered.getLedger().forEach([&](uint64_t, AccountType, const NoWithdrawableAccount& account){
+        total += account.getBalance();
+    });
+    cout << "Journal recovery: " << recovered.replayedRecords() << " tail records replayed in " << seconds
+         << " s, journal file holds " << filesystem::file_size(journalPath) / sizeof(JournalRecord) << " records, balances "
+         << (llround(total * 100) == llround(expected * 100) ? "match" : "DO NOT match") << endl;
+}
+
+
+// ---------------------------------------------------------------------------
+// Bulk balance reporting.
+// Balances are copied once into plain columns (id, type, cents) and every aggregate is a straight
+// scan over those arrays; the statement is written through one large buffer instead of a
+// flushed console line per account.
+// ---------------------------------------------------------------------------
+
+class BalanceColumns{
+    private:
+        vector<uint64_t> ids;
+        vector<uint8_t> types;
+        vector<int64_t> cents;
+
+    public:
+        void clear(){
+            ids.clear();
+            types.clear();
+            cents.clear();
+        }
+
+        void reserve(size_t count){
+            ids.reserve(count);
+            types.reserve(count);
+            cents.reserve(count);
+        }
+
+        void add(uint64_t id, AccountType type, int64_t balanceCents){
+            ids.push_back(id);
+            types.push_back(static_cast<uint8_t>(type));
+            cents.push_back(balanceCents);
+        }
+
+        size_t size() const { return ids.size(); }
+        uint64_t id(size_t row) const { return ids[row]; }
+        AccountType type(size_t row) const { return static_cast<AccountType>(types[row]); }
+        int64_t balanceCents(size_t row) const { return cents[row]; }
+        const int64_t* centsData() const { return cents.data(); }
+        const uint8_t* typesData() const { return types.data(); }
+};
+
+struct BalanceSummary{
+    size_t accounts = 0;
+    int64_t total = 0;
+    int64_t minimum = 0;
+    int64_t maximum = 0;
+    int64_t perType[3] = {};  // indexed by AccountType
+};
+
+// one pass over the columns, written without branches so the loop vectorizes
+BalanceSummary summarize(const BalanceColumns& columns){
+    BalanceSummary summary;
+    size_t n = columns.size();
+    if (n == 0) {
+        return summary;
+    }
+    const int64_t* cents = columns.centsData();
+    const uint8_t* types = columns.typesData();
+
+    int64_t total = 0, minimum = cents[0], maximum = cents[0];
+    int64_t saving = 0, current = 0, fixedDeposit = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t value = cents[i];
+        total += value;
+        minimum = min(minimum, value);
+        maximum = max(maximum, value);
+        saving += value & -static_cast<int64_t>(types[i] == static_cast<uint8_t>(AccountType::Saving));
+        current += value & -static_cast<int64_t>(types[i] == static_cast<uint8_t>(AccountType::Current));
+        fixedDeposit += value & -static_cast<int64_t>(types[i] == static_cast<uint8_t>(AccountType::FixedDeposit));
+    }
+
+    summary.accounts = n;
+    summary.total = total;
+    summary.minimum = minimum;
+    summary.maximum = maximum;
+    summary.perType[static_cast<int>(AccountType::Saving)] = saving;
+    summary.perType[static_cast<int>(AccountType::Current)] = current;
+    summary.perType[static_cast<int>(AccountType::FixedDeposit)] = fixedDeposit;
+    return summary;
+}
+
+// buffered report output, the buffer goes out with one fwrite whenever it fills up
+class ReportWriter{
+    private:
+        FILE* out;
+        string buffer;
+        bool failed = false;  // a short fwrite or failed fflush happened, the output is incomplete
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    public:
+        explicit ReportWriter(FILE* out) : out(out) {
+            buffer.reserve(BUFFER_SIZE);
+        }
+
+        ~ReportWriter(){
+            flush();
+        }
+
+        void append(string_view text){
+            if (buffer.size() + text.size() > BUFFER_SIZE) {
+                flush();
+            }
+            buffer.append(text);
+        }
+
+        void appendNumber(uint64_t value){
+            char digits[20];
+            append(string_view(digits, to_chars(digits, digits + sizeof(digits), value).ptr - digits));
+        }
+
+        // cents as "1234.05"
+        void appendCents(int64_t cents){
+            char digits[24];
+            char* end = digits;
+            uint64_t absolute = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+            if (cents < 0) {
+                *end++ = '-';
+            }
+            end = to_chars(end, digits + sizeof(digits), absolute / 100).ptr;
+            *end++ = '.';
+            *end++ = static_cast<char>('0' + absolute % 100 / 10);
+            *end++ = static_cast<char>('0' + absolute % 10);
+            append(string_view(digits, end - digits));
+        }
+
+        // false once any write failed, everything after that is dropped
+        bool flush(){
+            if (!failed && !buffer.empty()) {
+                failed = fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size();
+            }
+            buffer.clear();
+            if (!failed) {
+                failed = fflush(out) != 0;
+            }
+            return !failed;
+        }
+
+        bool ok() const{
+            return !failed;
+        }
+};
+
+void writeStatement(const BalanceColumns& columns, ReportWriter& writer){
+    static const string_view typeNames[] = {"saving", "current", "fixed_deposit"};
+    writer.append("account,type,balance\n");
+    for (size_t row = 0; row < columns.size(); row++) {
+        writer.appendNumber(columns.id(row));
+        writer.append(",");
+        writer.append(typeNames[static_cast<int>(columns.type(row))]);
+        writer.append(",");
+        writer.appendCents(columns.balanceCents(row));
+        writer.append("\n");
+    }
+}
+
+void writeSummary(const BalanceSummary& summary, ReportWriter& writer){
+    writer.append("accounts: ");
+    writer.appendNumber(summary.accounts);
+    writer.append("\ntotal: ");
+    writer.appendCents(summary.total);
+    writer.append("\nmin: ");
+    writer.appendCents(summary.minimum);
+    writer.append("\nmax: ");
+    writer.appendCents(summary.maximum);
+    writer.append("\nsaving: ");
+    writer.appendCents(summary.perType[static_cast<int>(AccountType::Saving)]);
+    writer.append("\ncurrent: ");
+    writer.appendCents(summary.perType[static_cast<int>(AccountType::Current)]);
+    writer.append("\nfixed deposit: ");
+    writer.appendCents(summary.perType[static_cast<int>(AccountType::FixedDeposit)]);
+    writer.append("\n");
+}
+
+
+// end-of-day style run: export columns, aggregate, write the full statement to a file
+void benchmarkBalanceReport(size_t accounts){
+    Ledger ledger;
+    for (size_t i = 0; i < accounts; i++) {
+        AccountType type = i % 3 == 0 ? AccountType::FixedDeposit : i % 3 == 1 ? AccountType::Saving : AccountType::Current;
+        ledger.open(type, static_cast<double>(i % 100000) / 7);
+    }
+
+    BalanceColumns columns;
+    auto start = chrono::steady_clock::now();
+    ledger.exportBalances(columns);
+    auto exported = chrono::steady_clock::now();
+    BalanceSummary summary = summarize(columns);
+    auto summarized = chrono::steady_clock::now();
+
+    FILE* file = fopen("statement.csv", "wb");
+    bool statementWritten = false;
+    if (file) {
+        {
+            ReportWriter writer(file);
+            writeStatement(columns, writer);
+            statementWritten = writer.flush();
+        }
+        statementWritten = fclose(file) == 0 && statementWritten;
+    }
+    auto written = chrono::steady_clock::now();
+
+    auto ms = [](auto from, auto to){ return chrono::duration<double, milli>(to - from).count(); };
+    cout << "Balance report over " << accounts << " accounts: export " << ms(start, exported) << " ms, aggregate "
+         << ms(exported, summarized) << " ms, statement " << ms(summarized, written) << " ms"
+         << (statementWritten ? "" : " (statement.csv could not be written)") << "\n";
+    ReportWriter console(stdout);
+    writeSummary(summary, console);
+}
+
+
+// ---------------------------------------------------------------------------
+// Nightly interest accrual.
+// Accounts are processed in blocks of a single type, so a block shares one rate: balances are loaded
+// into a local array, the rate math runs as one vectorizable loop, and interest is credited with
+// fetch_add. A deposit that lands while the job runs is never lost; it simply earns interest from the next run.
+// Interest is computed in 32.32 fixed point: whole cents are credited and the fraction of a cent is
+// carried per account into the next run, so small balances still earn their interest over time.
+// The carry lives in the engine only, a restart forgets less than one cent per account.
+// The engine writes balance cells directly; on a JournaledLedger run it through runBatchJob().
+// ---------------------------------------------------------------------------
+
+class InterestAccrualEngine{
+    private:
+        struct TypeGroup{
+            AccountType type;
+            vector<uint64_t> ids;
+            vector<AtomicBalance*> cells;
+            vector<uint32_t> carry;   // fraction of a cent owed to cells[i], in units of 2^-32 cent
+            int64_t dailyRateQ32 = 0; // daily rate as a 32.32 fixed-point fraction
+        };
+
+        Ledger& ledger;
+        vector<TypeGroup> groups;
+        WorkerPool pool;
+        static constexpr size_t BLOCK = 4096;
+
+        // interest for one block, returns the amount credited
+        static int64_t accrueBlock(AtomicBalance* const* cells, uint32_t* carry, size_t count, int64_t rateQ32){
+            int64_t interest[BLOCK];
+            for (size_t i = 0; i < count; i++) {
+                interest[i] = cells[i]->load();
+            }
+            // no interest on negative balances; balances up to ~2^43 cents stay within int64
+            for (size_t i = 0; i < count; i++) {
+                int64_t exact = max<int64_t>(0, interest[i]) * rateQ32 + carry[i];
+                interest[i] = exact >> 32;
+                carry[i] = static_cast<uint32_t>(exact);
+            }
+            int64_t credited = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (interest[i] != 0) {
+                    cells[i]->add(interest[i]);
+                    credited += interest[i];
+                }
+            }
+            return credited;
+        }
+
+    public:
+        // annual rates in basis points, accounts of other types earn nothing
+        InterestAccrualEngine(Ledger& ledger, int64_t savingBasisPoints, int64_t fixedDepositBasisPoints,
+                              unsigned threads = max(1u, thread::hardware_concurrency()))
+            : ledger(ledger), pool(threads) {
+            groups.push_back({AccountType::Saving, {}, {}, {}, llround(savingBasisPoints / 10000.0 / 365 * 4294967296.0)});
+            groups.push_back({AccountType::FixedDeposit, {}, {}, {}, llround(fixedDepositBasisPoints / 10000.0 / 365 * 4294967296.0)});
+            refresh();
+        }
+
+        // picks up accounts opened since the last refresh; carries follow their account id,
+        // since new accounts can land anywhere in the cell order
+        void refresh(){
+            for (auto& group : groups) {
+                unordered_map<uint64_t, uint32_t> owed;
+                for (size_t i = 0; i < group.ids.size(); i++) {
+                    if (group.carry[i] != 0) {
+                        owed.emplace(group.ids[i], group.carry[i]);
+                    }
+                }
+                ledger.balanceCells(group.type, group.ids, group.cells);
+                group.carry.assign(group.cells.size(), 0);
+                for (size_t i = 0; i < group.ids.size() && !owed.empty(); i++) {
+                    auto found = owed.find(group.ids[i]);
+                    if (found != owed.end()) {
+                        group.carry[i] = found->second;
+                        owed.erase(found);
+                    }
+                }
+            }
+        }
+
+        // one day of interest for every account, blocks are shared out to the pool's threads
+        int64_t accrueDay(){
+            vector<pair<TypeGroup*, size_t>> blocks;
+            for (auto& group : groups) {
+                for (size_t begin = 0; begin < group.cells.size(); begin += BLOCK) {
+                    blocks.emplace_back(&group, begin);
+                }
+            }
+
+            atomic<int64_t> credited{0};
+            pool.run(blocks.size(), 1, [&](size_t first, size_t last){
+                int64_t local = 0;
+                for (size_t b = first; b < last; b++) {
+                    TypeGroup& group = *blocks[b].first;
+                    size_t begin = blocks[b].second;
+                    size_t count = min(BLOCK, group.cells.size() - begin);
+                    local += accrueBlock(group.cells.data() + begin, group.carry.data() + begin, count, group.dailyRateQ32);
+                }
+                credited += local;
+            });
+            return credited.load();
+        }
+};
+
+
+// accrual over a large ledger while another thread keeps depositing: nothing may be lost
+void benchmarkInterestAccrual(size_t accounts, unsigned threads){
+    Ledger ledger;
+    vector<uint64_t> ids;
+    for (size_t i = 0; i < accounts; i++) {
+        AccountType type = i % 3 == 0 ? AccountType::FixedDeposit : i % 3 == 1 ? AccountType::Saving : AccountType::Current;
+        ids.push_back(ledger.open(type, 1000.0 + static_cast<double>(i % 1000)));
+    }
+    auto total = [&](){
+        BalanceColumns columns;
+        ledger.exportBalances(columns);
+        return summarize(columns).total;
+    };
+    int64_t before = total();
+
+    InterestAccrualEngine engine(ledger, 350, 700, threads); // 3.5% saving, 7% fixed deposit
+    atomic<bool> running{true};
+    int64_t deposited = 0;
+    thread depositor([&](){
+        mt19937_64 random(5);
+        while (running.load(memory_order_relaxed)) {
+            ledger.deposit(ids[random() % ids.size()], 1.0);
+            deposited += 100;
+        }
+    });
+
+    auto start = chrono::steady_clock::now();
+    int64_t credited = engine.accrueDay();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    running = false;
+    depositor.join();
+
+    bool consistent = total() == before + credited + deposited;
+    cout << "Interest accrual over " << accounts << " accounts: " << ms << " ms, credited "
+         << AtomicBalance::toAmount(credited) << ", concurrent deposits " << (consistent ? "kept" : "LOST") << '\n';
+}
+
+
 int main(){
     vector<NoWithdrawableAccount*> noWithdrawableAccounts;
     noWithdrawableAccounts.push_back(new FixedDepositAccount(3000));
@@ -139,6 +1470,11 @@ int main(){
     client.makeWithdrawal(200);
     client.displayBalances();
 
+    benchmarkLedgerContention(100000, 8, 200000);
+    benchmarkTransfers(10000, 16, 100000);
+    benchmarkJournalRecovery(10000, 1000000, 4);
+    benchmarkBalanceReport(500000);
+    benchmarkInterestAccrual(500000, 4);
 
     for (auto& account : noWithdrawableAccounts) {
         delete account;
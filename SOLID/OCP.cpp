@@ -1,33 +1,94 @@
 #include<iostream>
 #include<bits/stdc++.h>
+#include "../common/WorkerPool.h"
 using namespace std;
 
 
+// fixed-point money, stored as integer cents so totals and discounts are exact
+class Money{
+    private:
+        int64_t cents;
+
+    public:
+        constexpr Money() : cents(0) {}
+        constexpr explicit Money(int64_t cents) : cents(cents) {}
+
+        // rounds to the nearest cent, only meant for literals and external input
+        static Money fromDouble(double amount){
+            return Money(llround(amount * 100.0));
+        }
+
+        int64_t getCents() const {
+            return cents;
+        }
+
+        Money operator+(Money other) const { return Money(cents + other.cents); }
+        Money operator-(Money other) const { return Money(cents - other.cents); }
+        Money& operator+=(Money other) { cents += other.cents; return *this; }
+        Money& operator-=(Money other) { cents -= other.cents; return *this; }
+        bool operator<(Money other) const { return cents < other.cents; }
+
+        string toString() const {
+            int64_t absolute = cents < 0 ? -cents : cents;
+            string fraction = to_string(absolute % 100);
+            return (cents < 0 ? "-" : "") + to_string(absolute / 100) + "." + (fraction.size() == 1 ? "0" : "") + fraction;
+        }
+
+        friend ostream& operator<<(ostream& out, Money money){
+            return out << money.toString();
+        }
+};
+
 
 class Product{
     private:
         string name;
-        double price;
+        Money price;
+        string category;
 
     public:
-        Product(const string& name, double price)
-            : name(name), price(price) {}
+        Product(const string& name, Money price, const string& category = "")
+            : name(name), price(price), category(category) {}
 
-        string getName() const {
+        const string& getName() const {
             return name;
         }
 
-        double getPrice() const {
+        const string& getCategory() const {
+            return category;
+        }
+
+        Money getPrice() const {
             return price;
         }
 };
 
 
+// amount off for a percentage discount, chosen so the remaining total is rounded half up to the cent;
+// every percentage based discount and rule goes through it so the same rate always gives the same cents
+inline int64_t percentOff(int64_t cents, int64_t basisPoints){
+    return cents - (cents * (10000 - basisPoints) + 5000) / 10000;
+}
+
+
 //  abstract class for discount strategy, we can add new discount types without changing the shopping cart class
 
 class Discount{
     public:
-        virtual double apply(double total) const = 0; // Pure virtual function
+        virtual Money apply(Money total) const = 0; // Pure virtual function
+
+        // strategies that look at individual items (per-item / per-category rules) override this one
+        virtual Money applyToCart(const vector<Product>&, Money subtotal) const {
+            return apply(subtotal);
+        }
+
+        // prices a whole batch of totals with one virtual call, concrete strategies override it with a tight loop
+        virtual void applyBatch(const Money* totals, Money* out, size_t count) const {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = apply(totals[i]);
+            }
+        }
+
         virtual ~Discount() = default; // Virtual destructor
 };
 
@@ -36,21 +97,32 @@ class Discount{
 class NoDiscount: public Discount{
 
     public:
-        double apply(double total) const override{
+        Money apply(Money total) const override{
             return total; // No discount applied
         }
+
+        void applyBatch(const Money* totals, Money* out, size_t count) const override{
+            copy(totals, totals + count, out);
+        }
 };
 
 // Example of a percentage discount strategy
 class PercentageDiscount: public Discount{
     private:
-        double percentage;
+        int64_t basisPoints; // 1% = 100 basis points, keeps the rate an exact integer
 
     public:
-        PercentageDiscount(double percentage) : percentage(percentage) {}
+        PercentageDiscount(double percentage) : basisPoints(llround(percentage * 100)) {}
 
-        double apply(double total) const override {
-            return total * (1 - percentage / 100); // Apply percentage discount
+        Money apply(Money total) const override {
+            // Apply percentage discount, rounding half up to the nearest cent
+            return Money(total.getCents() - percentOff(total.getCents(), basisPoints));
+        }
+
+        void applyBatch(const Money* totals, Money* out, size_t count) const override{
+            for (size_t i = 0; i < count; i++) {
+                out[i] = Money(totals[i].getCents() - percentOff(totals[i].getCents(), basisPoints));
+            }
         }
 };
 
@@ -58,42 +130,403 @@ class PercentageDiscount: public Discount{
 
 class FlatDiscount: public Discount{
     private:
-    double amount;
+    Money amount;
 
     public:
-        FlatDiscount(double amount ) : amount(amount) {}
+        FlatDiscount(Money amount ) : amount(amount) {}
 
-        double apply(double total) const override{
-            return max(0.0, total - amount); // Apply flat discount, ensuring total doesn't go negative
+        Money apply(Money total) const override{
+            return max(Money(), total - amount); // Apply flat discount, ensuring total doesn't go negative
+        }
+
+        void applyBatch(const Money* totals, Money* out, size_t count) const override{
+            const int64_t off = amount.getCents();
+            for (size_t i = 0; i < count; i++) {
+                out[i] = Money(max<int64_t>(0, totals[i].getCents() - off));
+            }
         }
 };
 
 
 
+// ---------------------------------------------------------------------------
+// Stackable discount rules.
+// A promotion is a chain of small rules. Each rule only moves the running "amount off" of a cart,
+// so rules compose in order and the final total is subtotal - amount off (never below zero).
+// Chains are compiled once: item / category names become slot indexes, and evaluation is a flat
+// loop over a vector of variants (or a fold over a tuple for fixed chains) with no virtual call per rule.
+// ---------------------------------------------------------------------------
+
+// maps item names and categories to small slot indexes, the per-cart totals live in an array of size()
+// entries. Slot 0 is never handed out and always reads as zero.
+class SlotTable{
+    public:
+        static constexpr uint32_t NO_SLOT = 0;
+        static constexpr size_t INLINE_SLOTS = 64; // carts priced by chains up to this size keep their totals on the stack
+
+        uint32_t itemSlot(const string& name){
+            return slotIn(itemSlots, name);
+        }
+
+        uint32_t categorySlot(const string& category){
+            return slotIn(categorySlots, category);
+        }
+
+        // number of entries a totals array needs, including the zero slot
+        size_t size() const {
+            return 1 + itemSlots.size() + categorySlots.size();
+        }
+
+        // one pass over the cart, summing prices into the slots the rules asked for
+        // products are looked up by their own name / category strings, nothing is allocated per line
+        void collect(const vector<Product>& products, int64_t* totals) const {
+            if (size() == 1) {
+                return;
+            }
+            for (const auto& product : products) {
+                if (!itemSlots.empty()) {
+                    auto item = itemSlots.find(product.getName());
+                    if (item != itemSlots.end()) {
+                        totals[item->second] += product.getPrice().getCents();
+                    }
+                }
+                if (!categorySlots.empty()) {
+                    auto category = categorySlots.find(product.getCategory());
+                    if (category != categorySlots.end()) {
+                        totals[category->second] += product.getPrice().getCents();
+                    }
+                }
+            }
+        }
+
+    private:
+        unordered_map<string, uint32_t> itemSlots;
+        unordered_map<string, uint32_t> categorySlots;
+
+        uint32_t slotIn(unordered_map<string, uint32_t>& slots, const string& key){
+            auto it = slots.find(key);
+            if (it != slots.end()) {
+                return it->second;
+            }
+            uint32_t slot = static_cast<uint32_t>(size());
+            slots.emplace(key, slot);
+            return slot;
+        }
+};
+
+struct DiscountContext{
+    const int64_t* slotTotals;
+    int64_t subtotal;
+};
+
+// percentage off every unit of one product
+struct ItemPercentRule{
+    string name;
+    int64_t basisPoints;
+    uint32_t slot = SlotTable::NO_SLOT;
+
+    void resolve(SlotTable& table) { slot = table.itemSlot(name); }
+    int64_t apply(const DiscountContext& ctx, int64_t off) const { return off + percentOff(ctx.slotTotals[slot], basisPoints); }
+};
+
+// percentage off everything in one category
+struct CategoryPercentRule{
+    string category;
+    int64_t basisPoints;
+    uint32_t slot = SlotTable::NO_SLOT;
+
+    void resolve(SlotTable& table) { slot = table.categorySlot(category); }
+    int64_t apply(const DiscountContext& ctx, int64_t off) const { return off + percentOff(ctx.slotTotals[slot], basisPoints); }
+};
+
+// percentage off whatever is still left to pay after the earlier rules
+struct CartPercentRule{
+    int64_t basisPoints;
+
+    void resolve(SlotTable&) {}
+    int64_t apply(const DiscountContext& ctx, int64_t off) const { return off + percentOff(ctx.subtotal - off, basisPoints); }
+};
+
+struct CartFlatRule{
+    Money amount;
+
+    void resolve(SlotTable&) {}
+    int64_t apply(const DiscountContext&, int64_t off) const { return off + amount.getCents(); }
+};
+
+// flat amount off once the subtotal reaches a minimum, written without a branch
+struct ThresholdRule{
+    Money minimum;
+    Money amount;
+
+    void resolve(SlotTable&) {}
+    int64_t apply(const DiscountContext& ctx, int64_t off) const {
+        return off + static_cast<int64_t>(ctx.subtotal >= minimum.getCents()) * amount.getCents();
+    }
+};
+
+// upper bound on the total amount off from all rules before it
+struct CapRule{
+    Money maximum;
+
+    void resolve(SlotTable&) {}
+    int64_t apply(const DiscountContext&, int64_t off) const { return min(off, maximum.getCents()); }
+};
+
+using DiscountRule = variant<ItemPercentRule, CategoryPercentRule, CartPercentRule, CartFlatRule, ThresholdRule, CapRule>;
+
+
+// shared plumbing of both rule chains: cart scan + final clamp, the chain itself only supplies evaluate()
+template<typename Chain>
+class RuleChainDiscount: public Discount{
+    public:
+        Money evaluate(const DiscountContext& ctx) const {
+            int64_t off = static_cast<const Chain*>(this)->amountOff(ctx);
+            return Money(max<int64_t>(0, ctx.subtotal - off));
+        }
+
+        // without the items only cart level rules can fire, item / category slots read as zero.
+        // This is also the path BatchPricingEngine takes (through applyBatch), so item and category rules
+        // contribute nothing there; carts with such promotions are priced with applyToCart.
+        Money apply(Money total) const override {
+            return withSlotTotals([&](int64_t* totals){ return evaluate({totals, total.getCents()}); });
+        }
+
+        // no items on this path, so the slots stay zero and one zeroed array serves the whole run of carts
+        void applyBatch(const Money* totals, Money* out, size_t count) const override {
+            withSlotTotals([&](int64_t* slotTotals){
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = evaluate({slotTotals, totals[i].getCents()});
+                }
+                return Money();
+            });
+        }
+
+        Money applyToCart(const vector<Product>& products, Money subtotal) const override {
+            return withSlotTotals([&](int64_t* totals){
+                static_cast<const Chain*>(this)->slotTable().collect(products, totals);
+                return evaluate({totals, subtotal.getCents()});
+            });
+        }
+
+    private:
+        // runs use(totals) on zeroed slot totals, on the stack for the usual small chains, on the heap beyond that
+        template<typename Use>
+        Money withSlotTotals(Use&& use) const {
+            size_t slots = static_cast<const Chain*>(this)->slotTable().size();
+            int64_t inlineTotals[SlotTable::INLINE_SLOTS] = {};
+            vector<int64_t> heapTotals;
+            int64_t* totals = inlineTotals;
+            if (slots > SlotTable::INLINE_SLOTS) {
+                heapTotals.assign(slots, 0);
+                totals = heapTotals.data();
+            }
+            return use(totals);
+        }
+};
+
+// rule chain assembled at runtime (promotions loaded from config), compiled once into a flat program
+class CompiledDiscount: public RuleChainDiscount<CompiledDiscount>{
+    private:
+        vector<DiscountRule> program;
+        SlotTable slots;
+
+    public:
+        CompiledDiscount(vector<DiscountRule> rules) : program(move(rules)) {
+            for (auto& rule : program) {
+                visit([&](auto& r){ r.resolve(slots); }, rule);
+            }
+        }
+
+        int64_t amountOff(const DiscountContext& ctx) const {
+            int64_t off = 0;
+            for (const auto& rule : program) {
+                off = visit([&](const auto& r){ return r.apply(ctx, off); }, rule);
+            }
+            return off;
+        }
+
+        const SlotTable& slotTable() const { return slots; }
+};
+
+// builder so promotions read as a chain: DiscountPipeline().add(...).add(...).compile()
+class DiscountPipeline{
+    private:
+        vector<DiscountRule> rules;
+
+    public:
+        DiscountPipeline& add(DiscountRule rule){
+            rules.push_back(move(rule));
+            return *this;
+        }
+
+        CompiledDiscount compile() const {
+            return CompiledDiscount(rules);
+        }
+};
+
+// rule chain fixed at build time, the whole chain inlines into a single expression
+template<typename... Rules>
+class StaticDiscountChain: public RuleChainDiscount<StaticDiscountChain<Rules...>>{
+    private:
+        tuple<Rules...> rules;
+        SlotTable slots;
+
+    public:
+        StaticDiscountChain(Rules... r) : rules(move(r)...) {
+            std::apply([&](auto&... rule){ (rule.resolve(slots), ...); }, rules);
+        }
+
+        int64_t amountOff(const DiscountContext& ctx) const {
+            int64_t off = 0;
+            std::apply([&](const auto&... rule){ ((off = rule.apply(ctx, off)), ...); }, rules);
+            return off;
+        }
+
+        const SlotTable& slotTable() const { return slots; }
+};
+
+
 class ShoppingCart {
     private:
         vector<Product> products;
         Discount* discount;
+        Money subtotal; // running sum of product prices, updated on every add/remove
 
     public:
         ShoppingCart(Discount* discount): discount(discount) {}
 
         void addProduct(const Product& product) {
             products.push_back(product);
+            subtotal += product.getPrice();
+        }
+
+        void removeProduct(size_t index) {
+            if (index < products.size()) {
+                subtotal -= products[index].getPrice();
+                products.erase(products.begin() + index);
+            }
         }
 
         const vector<Product>& getProducts() const {
             return products;
         }
 
-        double calculateTotal() const {
-            double total = 0.0;
-            for (const auto& product : products) {
-                total += product.getPrice();
+        Money calculateTotal() const {
+            //  we dont need to change this method when we add new discount types, we just need to create new discount class and pass it to the shopping cart
+            return discount->applyToCart(products, subtotal);
+        }
+};
+
+
+// many carts in one CSR layout: the prices of cart i are prices[offsets[i] .. offsets[i + 1])
+// discountIds[i] picks the strategy for cart i from the pricing engine's discount table
+class CartBatch{
+    private:
+        vector<Money> prices;
+        vector<size_t> offsets{0};
+        vector<uint32_t> discountIds;
+
+    public:
+        void reserve(size_t carts, size_t lines){
+            prices.reserve(lines);
+            offsets.reserve(carts + 1);
+            discountIds.reserve(carts);
+        }
+
+        void addCart(const ShoppingCart& cart, uint32_t discountId){
+            for (const auto& product : cart.getProducts()) {
+                prices.push_back(product.getPrice());
             }
+            offsets.push_back(prices.size());
+            discountIds.push_back(discountId);
+        }
 
-            //  we dont need to change this method when we add new discount types, we just need to create new discount class and pass it to the shopping cart
-            return discount->apply(total);
+        void addCart(const vector<Money>& cartPrices, uint32_t discountId){
+            prices.insert(prices.end(), cartPrices.begin(), cartPrices.end());
+            offsets.push_back(prices.size());
+            discountIds.push_back(discountId);
+        }
+
+        size_t size() const {
+            return discountIds.size();
+        }
+
+        const vector<Money>& getPrices() const { return prices; }
+        const vector<size_t>& getOffsets() const { return offsets; }
+        const vector<uint32_t>& getDiscountIds() const { return discountIds; }
+};
+
+
+// prices a whole CartBatch: carts are grouped by discount so every strategy sees contiguous runs of subtotals
+// (one applyBatch call per chunk, not one virtual call per cart). Chunks never straddle two groups, so one
+// parallel pass over the chunks computes subtotals, applies the discount and scatters back to cart order.
+// Only cart totals reach the discounts here, so item and category rules of a rule chain do not fire
+// (see RuleChainDiscount::apply); price carts with such promotions through ShoppingCart::calculateTotal.
+class BatchPricingEngine{
+    private:
+        vector<const Discount*> discounts;
+        mutable WorkerPool pool;
+        static constexpr size_t CHUNK = 4096;
+
+    public:
+        BatchPricingEngine(const vector<const Discount*>& discounts, unsigned threads = max(1u, thread::hardware_concurrency()))
+            : discounts(discounts), pool(threads) {}
+
+        // throws invalid_argument when a cart refers to a discount id outside the engine's table
+        vector<Money> price(const CartBatch& batch) const {
+            const vector<Money>& prices = batch.getPrices();
+            const vector<size_t>& offsets = batch.getOffsets();
+            const vector<uint32_t>& ids = batch.getDiscountIds();
+            size_t carts = batch.size();
+
+            for (size_t cart = 0; cart < carts; cart++) {
+                if (ids[cart] >= discounts.size()) {
+                    throw invalid_argument("cart " + to_string(cart) + " uses unknown discount id " + to_string(ids[cart]));
+                }
+            }
+
+            // counting sort of carts by discount id
+            vector<size_t> groupStart(discounts.size() + 1, 0);
+            for (uint32_t id : ids) {
+                groupStart[id + 1]++;
+            }
+            for (size_t g = 0; g < discounts.size(); g++) {
+                groupStart[g + 1] += groupStart[g];
+            }
+            vector<size_t> order(carts);
+            vector<size_t> fill(groupStart.begin(), groupStart.end() - 1);
+            for (size_t cart = 0; cart < carts; cart++) {
+                order[fill[ids[cart]]++] = cart;
+            }
+
+            // chunks in grouped order, cut at group boundaries: (group, first position, end position)
+            vector<array<size_t, 3>> chunks;
+            for (size_t g = 0; g < discounts.size(); g++) {
+                for (size_t begin = groupStart[g]; begin < groupStart[g + 1]; begin += CHUNK) {
+                    chunks.push_back({g, begin, min(groupStart[g + 1], begin + CHUNK)});
+                }
+            }
+
+            vector<Money> grouped(carts), discounted(carts), totals(carts);
+            pool.run(chunks.size(), 1, [&](size_t first, size_t last){
+                for (size_t c = first; c < last; c++) {
+                    auto [g, begin, end] = chunks[c];
+                    for (size_t k = begin; k < end; k++) {
+                        size_t cart = order[k];
+                        int64_t sum = 0;
+                        for (size_t line = offsets[cart]; line < offsets[cart + 1]; line++) {
+                            sum += prices[line].getCents();
+                        }
+                        grouped[k] = Money(sum);
+                    }
+                    discounts[g]->applyBatch(grouped.data() + begin, discounted.data() + begin, end - begin);
+                    for (size_t k = begin; k < end; k++) {
+                        totals[order[k]] = discounted[k];
+                    }
+                }
+            });
+            return totals;
         }
 };
 
@@ -107,11 +540,77 @@ int main(){
     ShoppingCart cart(discount);
 
     // Add products to the cart
-    cart.addProduct(Product("Laptop", 1000.0));
-    cart.addProduct(Product("Smartphone", 500.0));
+    cart.addProduct(Product("Laptop", Money::fromDouble(1000.0)));
+    cart.addProduct(Product("Smartphone", Money::fromDouble(500.0)));
 
     cout << "Total price: $" << cart.calculateTotal() << endl;
 
+    // nightly re-pricing: many carts priced together, each with its own discount
+    NoDiscount noDiscount;
+    FlatDiscount flatDiscount(Money::fromDouble(25.0));
+    BatchPricingEngine engine({&noDiscount, discount, &flatDiscount});
+
+    const size_t carts = 200000;
+    CartBatch batch;
+    batch.reserve(carts, carts * 8);
+    batch.addCart(cart, 1);
+    for (size_t i = 1; i < carts; i++) {
+        vector<Money> cartPrices;
+        for (size_t line = 0; line < 8; line++) {
+            cartPrices.push_back(Money(static_cast<int64_t>(100 + (i * 7 + line * 13) % 5000)));
+        }
+        batch.addCart(cartPrices, static_cast<uint32_t>(i % 3));
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<Money> totals = engine.price(batch);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Batch priced " << totals.size() << " carts in " << ms << " ms, first cart: $" << totals[0] << endl;
+
+
+    // stacked promotion: 20% off laptops, 5% off electronics, 10% off the rest, $50 off over $1000, at most $300 off
+    CompiledDiscount promotion = DiscountPipeline()
+        .add(ItemPercentRule{"Laptop", 2000})
+        .add(CategoryPercentRule{"electronics", 500})
+        .add(CartPercentRule{1000})
+        .add(ThresholdRule{Money::fromDouble(1000.0), Money::fromDouble(50.0)})
+        .add(CapRule{Money::fromDouble(300.0)})
+        .compile();
+
+    ShoppingCart promoCart(&promotion);
+    promoCart.addProduct(Product("Laptop", Money::fromDouble(1000.0), "electronics"));
+    promoCart.addProduct(Product("Headphones", Money::fromDouble(200.0), "electronics"));
+    promoCart.addProduct(Product("Book", Money::fromDouble(40.0), "books"));
+    cout << "Promotion total: $" << promoCart.calculateTotal() << endl;
+
+    StaticDiscountChain<CartPercentRule, ThresholdRule, CapRule> fixedPromotion(
+        CartPercentRule{1000}, ThresholdRule{Money::fromDouble(1000.0), Money::fromDouble(50.0)}, CapRule{Money::fromDouble(300.0)});
+    cout << "Fixed promotion on $1500: $" << fixedPromotion.apply(Money::fromDouble(1500.0)) << endl;
+
+    // cost of a 50 rule chain on a 20 line cart, including the scan of the cart lines
+    DiscountPipeline longPipeline;
+    for (int r = 0; r < 50; r++) {
+        switch (r % 5) {
+            case 0: longPipeline.add(CategoryPercentRule{"category-" + to_string(r), 100}); break;
+            case 1: longPipeline.add(CartPercentRule{50}); break;
+            case 2: longPipeline.add(ThresholdRule{Money(10000 * r), Money(100)}); break;
+            case 3: longPipeline.add(CartFlatRule{Money(10)}); break;
+            default: longPipeline.add(CapRule{Money(1000000)}); break;
+        }
+    }
+    CompiledDiscount longChain = longPipeline.compile();
+    ShoppingCart longCart(&longChain);
+    for (int line = 0; line < 20; line++) {
+        longCart.addProduct(Product("item-" + to_string(line), Money(5000 + 100 * line), "category-" + to_string(line % 15 * 5)));
+    }
+    const int evaluations = 200000;
+    volatile int64_t sink = 0;
+    auto ruleStart = chrono::steady_clock::now();
+    for (int i = 0; i < evaluations; i++) {
+        sink = sink + longCart.calculateTotal().getCents();
+    }
+    double ruleNs = chrono::duration<double, nano>(chrono::steady_clock::now() - ruleStart).count() / evaluations;
+    cout << "50 stacked rules: " << ruleNs << " ns per cart" << endl;
 
     delete discount; // Clean up the dynamically allocated discount object
     return 0;
@@ -1,9 +1,90 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <random>
 
 using namespace std;
 
+/*
+    =========================
+    Money Class
+    Responsibility:
+    - Exact fixed-point amount, stored as integer cents
+    - Reason to change: currency / precision rules change
+    Sums of cents never drift the way repeated double additions do.
+    =========================
+*/
+class Money {
+private:
+    int64_t cents;
+
+public:
+    constexpr Money() : cents(0) {}
+    constexpr explicit Money(int64_t cents) : cents(cents) {}
+
+    // rounds to the nearest cent, only meant for literals and external input
+    static Money fromDouble(double amount) {
+        return Money(llround(amount * 100.0));
+    }
+
+    int64_t getCents() const {
+        return cents;
+    }
+
+    Money operator+(Money other) const { return Money(cents + other.cents); }
+    Money operator-(Money other) const { return Money(cents - other.cents); }
+    Money operator*(int64_t quantity) const { return Money(cents * quantity); }
+    Money& operator+=(Money other) { cents += other.cents; return *this; }
+    Money& operator-=(Money other) { cents -= other.cents; return *this; }
+    bool operator==(Money other) const { return cents == other.cents; }
+    bool operator!=(Money other) const { return cents != other.cents; }
+    bool operator<(Money other) const { return cents < other.cents; }
+
+    // "1234.50", always two decimals
+    string toString() const {
+        int64_t absolute = cents < 0 ? -cents : cents;
+        string fraction = to_string(absolute % 100);
+        return (cents < 0 ? "-" : "") + to_string(absolute / 100) + "."
+             + (fraction.size() == 1 ? "0" : "") + fraction;
+    }
+
+    // writes "1234.50" into [first, last) without allocating, returns one past the last char
+    // (24 chars always suffice for any int64 amount)
+    char* writeTo(char* first, char* last) const {
+        uint64_t absolute = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+        if (cents < 0) {
+            *first++ = '-';
+        }
+        first = to_chars(first, last, absolute / 100).ptr;
+        uint64_t fraction = absolute % 100;
+        *first++ = '.';
+        *first++ = static_cast<char>('0' + fraction / 10);
+        *first++ = static_cast<char>('0' + fraction % 10);
+        return first;
+    }
+
+    friend ostream& operator<<(ostream& out, Money money) {
+        return out << money.toString();
+    }
+};
+
+
 /*
     =========================
     Product Class
@@ -15,17 +96,17 @@ using namespace std;
 class Product {
 private:
     string name;
-    double price;
+    Money price;
 
 public:
-    Product(const string& name, double price)
+    Product(const string& name, Money price)
         : name(name), price(price) {}
 
-    string getName() const {
+    const string& getName() const {
         return name;
     }
 
-    double getPrice() const {
+    Money getPrice() const {
         return price;
     }
 };
@@ -39,28 +120,219 @@ public:
     - Add/remove products
     - Calculate total
     - Reason to change: cart business logic changes
+    The total is kept up to date on every add/remove, so the payment,
+    invoice and any other reader get it in O(1).
     =========================
 */
 class ShoppingCart {
 private:
     vector<Product> products;  // Encapsulated
+    Money total;
 
 public:
     void addProduct(const Product& product) {
         products.push_back(product);
+        total += product.getPrice();
+    }
+
+    void removeProduct(size_t index) {
+        if (index < products.size()) {
+            total -= products[index].getPrice();
+            products.erase(products.begin() + index);
+        }
     }
 
     const vector<Product>& getProducts() const {
         return products;
     }
 
-    double calculateTotal() const {
-        double total = 0.0;
-        for (const auto& product : products) {
-            total += product.getPrice();
+    Money calculateTotal() const {
+        return total;
+    }
+};
+
+
+/*
+    =========================
+    NameTable Class
+    Responsibility:
+    - Intern product names, each distinct name is stored once
+    - Reason to change: naming / catalog lookup changes
+    =========================
+*/
+class NameTable {
+private:
+    vector<string> names;
+    unordered_map<string, uint32_t> ids;
+
+public:
+    uint32_t intern(const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
         }
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    const string& name(uint32_t id) const {
+        return names[id];
+    }
+};
+
+
+/*
+    =========================
+    ColumnarCart Class
+    Responsibility:
+    - Same cart state as ShoppingCart, stored column by column
+      (prices, quantities and sku ids in separate contiguous arrays)
+    - Reason to change: cart business logic changes
+    Totals only touch the price and quantity columns, so the kernel streams
+    two dense arrays instead of hopping over Product objects and their strings.
+    Unit prices are kept as 32-bit cents (up to $42,949,672.95), which halves
+    the bytes streamed and keeps every price * quantity product exact in 64 bits.
+    =========================
+*/
+class ColumnarCart {
+private:
+    NameTable& names;
+    vector<uint32_t> prices;  // unit price in cents
+    vector<uint32_t> quantities;
+    vector<uint32_t> skus;  // index into NameTable
+    Money total;
+
+public:
+    explicit ColumnarCart(NameTable& names) : names(names) {}
+
+    void reserve(size_t lines) {
+        prices.reserve(lines);
+        quantities.reserve(lines);
+        skus.reserve(lines);
+    }
+
+    // false when the unit price does not fit the 32-bit price column
+    bool addProduct(const Product& product, uint32_t quantity = 1) {
+        int64_t cents = product.getPrice().getCents();
+        if (cents < 0 || cents > numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        prices.push_back(static_cast<uint32_t>(cents));
+        quantities.push_back(quantity);
+        skus.push_back(names.intern(product.getName()));
+        total += product.getPrice() * quantity;
+        return true;
+    }
+
+    // swaps the last line into the hole, line order is not part of the cart state
+    void removeLine(size_t line) {
+        if (line >= prices.size()) {
+            return;
+        }
+        total -= Money(prices[line]) * quantities[line];
+        prices[line] = prices.back();
+        quantities[line] = quantities.back();
+        skus[line] = skus.back();
+        prices.pop_back();
+        quantities.pop_back();
+        skus.pop_back();
+    }
+
+    size_t size() const {
+        return prices.size();
+    }
+
+    const string& getName(size_t line) const {
+        return names.name(skus[line]);
+    }
+
+    Money getPrice(size_t line) const {
+        return Money(prices[line]);
+    }
+
+    uint32_t getQuantity(size_t line) const {
+        return quantities[line];
+    }
+
+    Money calculateTotal() const {
         return total;
     }
+
+    // Full rescan of the columns, used to cross-check the running total.
+    // Four independent accumulators keep the multiply-adds from waiting on each
+    // other, which is what makes it beat the row scan already at -O2 (no
+    // -O3 / -march=native needed); at -O3 the same loop also vectorizes.
+    Money recomputeTotal() const {
+        const uint32_t* price = prices.data();
+        const uint32_t* quantity = quantities.data();
+        size_t n = prices.size();
+        uint64_t lane0 = 0, lane1 = 0, lane2 = 0, lane3 = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            lane0 += uint64_t(price[i]) * quantity[i];
+            lane1 += uint64_t(price[i + 1]) * quantity[i + 1];
+            lane2 += uint64_t(price[i + 2]) * quantity[i + 2];
+            lane3 += uint64_t(price[i + 3]) * quantity[i + 3];
+        }
+        for (; i < n; i++) {
+            lane0 += uint64_t(price[i]) * quantity[i];
+        }
+        return Money(static_cast<int64_t>(lane0 + lane1 + lane2 + lane3));
+    }
+};
+
+
+/*
+    =========================
+    InvoiceFormatter Class
+    Responsibility:
+    - Write invoice text into a caller-owned buffer
+    - Reason to change: invoice formatting changes
+    The buffer is appended to and never shrunk, so once it has grown to the
+    size of a typical batch, formatting more invoices allocates nothing.
+    =========================
+*/
+class InvoiceFormatter {
+private:
+    static void appendMoney(string& out, Money amount) {
+        char digits[24];
+        out.append(digits, amount.writeTo(digits, digits + sizeof(digits)));
+    }
+
+public:
+    void format(const ShoppingCart& cart, string& out) const {
+        out.append("\n===== Invoice =====\n");
+
+        for (const auto& product : cart.getProducts()) {
+            out.append(product.getName());
+            out.append(" : ");
+            appendMoney(out, product.getPrice());
+            out.push_back('\n');
+        }
+
+        out.append("-------------------\n");
+        out.append("Total: ");
+        appendMoney(out, cart.calculateTotal());
+        out.push_back('\n');
+    }
+
+    void format(const ColumnarCart& cart, string& out) const {
+        out.append("\n===== Invoice =====\n");
+
+        for (size_t line = 0; line < cart.size(); line++) {
+            out.append(cart.getName(line));
+            out.append(" : ");
+            appendMoney(out, cart.getPrice(line) * cart.getQuantity(line));
+            out.push_back('\n');
+        }
+
+        out.append("-------------------\n");
+        out.append("Total: ");
+        appendMoney(out, cart.calculateTotal());
+        out.push_back('\n');
+    }
 };
 
 
@@ -75,17 +347,230 @@ public:
 class InvoiceGenerator {
 public:
     string generate(const ShoppingCart& cart) const {
-        string invoice = "\n===== Invoice =====\n";
+        string invoice;
+        InvoiceFormatter().format(cart, invoice);
+        return invoice;
+    }
+};
+
+
+/*
+    =========================
+    BulkWriter Class
+    Responsibility:
+    - Buffered output to a file, one fwrite per full buffer
+    - Reason to change: output medium changes
+    =========================
+*/
+class BulkWriter {
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t used = 0;
+    size_t written = 0;
+    bool failed = false;  // a short or failed write happened, the file is incomplete
+
+    void writeOut(const char* data, size_t length) {
+        if (failed) {
+            return;
+        }
+        size_t done = fwrite(data, 1, length, file);
+        written += done;
+        failed = done != length;
+    }
+
+public:
+    explicit BulkWriter(const string& path, size_t bufferSize = 1 << 20)
+        : file(fopen(path.c_str(), "wb")), buffer(bufferSize) {}
+
+    ~BulkWriter() {
+        flush();
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    BulkWriter(const BulkWriter&) = delete;
+    BulkWriter& operator=(const BulkWriter&) = delete;
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    // false once any write failed (disk full, I/O error), everything after that is dropped
+    bool ok() const {
+        return file != nullptr && !failed;
+    }
+
+    void append(const char* data, size_t length) {
+        if (used + length > buffer.size()) {
+            flush();
+            if (length > buffer.size()) {
+                if (file) {
+                    writeOut(data, length);
+                }
+                return;
+            }
+        }
+        memcpy(buffer.data() + used, data, length);
+        used += length;
+    }
+
+    void append(const string& text) {
+        append(text.data(), text.size());
+    }
+
+    void append(char c) {
+        append(&c, 1);
+    }
+
+    void appendMoney(Money amount) {
+        char digits[24];
+        append(digits, amount.writeTo(digits, digits + sizeof(digits)) - digits);
+    }
+
+    void appendNumber(uint64_t value) {
+        char digits[20];
+        append(digits, to_chars(digits, digits + sizeof(digits), value).ptr - digits);
+    }
+
+    // raw native-endian bytes of a trivially copyable value
+    template <typename T>
+    void appendRaw(T value) {
+        append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // pushes buffered bytes down to the OS, returns ok()
+    bool flush() {
+        if (file && used > 0) {
+            writeOut(buffer.data(), used);
+            used = 0;
+        }
+        if (file && !failed && fflush(file) != 0) {
+            failed = true;
+        }
+        return ok();
+    }
+
+    size_t bytesWritten() const {
+        return written + used;
+    }
+};
+
+
+/*
+    =========================
+    InvoiceExporter Classes
+    Responsibility:
+    - Serialize invoices in machine-readable formats straight from cart lines
+    - Reason to change: export format changes
+    =========================
+*/
+class InvoiceExporter {
+public:
+    virtual void begin(BulkWriter&) const {}
+    virtual void write(uint64_t invoiceId, const ShoppingCart& cart, BulkWriter& out) const = 0;
+    virtual void end(BulkWriter&) const {}
+    virtual ~InvoiceExporter() = default;
+};
+
+// one row per line item: invoice_id,line,name,price
+class CsvInvoiceExporter : public InvoiceExporter {
+private:
+    static void appendField(const string& text, BulkWriter& out) {
+        if (text.find_first_of(",\"\n") == string::npos) {
+            out.append(text);
+            return;
+        }
+        out.append('"');
+        for (char c : text) {
+            if (c == '"') {
+                out.append('"');
+            }
+            out.append(c);
+        }
+        out.append('"');
+    }
+
+public:
+    void begin(BulkWriter& out) const override {
+        out.append("invoice_id,line,name,price\n");
+    }
 
+    void write(uint64_t invoiceId, const ShoppingCart& cart, BulkWriter& out) const override {
+        uint64_t line = 0;
         for (const auto& product : cart.getProducts()) {
-            invoice += product.getName() + " : " 
-                     + to_string(product.getPrice()) + "\n";
+            out.appendNumber(invoiceId);
+            out.append(',');
+            out.appendNumber(line++);
+            out.append(',');
+            appendField(product.getName(), out);
+            out.append(',');
+            out.appendMoney(product.getPrice());
+            out.append('\n');
         }
+    }
+};
 
-        invoice += "-------------------\n";
-        invoice += "Total: " + to_string(cart.calculateTotal()) + "\n";
+// JSON Lines: one object per invoice
+class JsonInvoiceExporter : public InvoiceExporter {
+private:
+    static void appendString(const string& text, BulkWriter& out) {
+        out.append('"');
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out.append('\\');
+                out.append(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[7];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out.append(escaped, 6);
+            } else {
+                out.append(c);
+            }
+        }
+        out.append('"');
+    }
 
-        return invoice;
+public:
+    void write(uint64_t invoiceId, const ShoppingCart& cart, BulkWriter& out) const override {
+        out.append("{\"invoice\":");
+        out.appendNumber(invoiceId);
+        out.append(",\"items\":[");
+        bool first = true;
+        for (const auto& product : cart.getProducts()) {
+            out.append(first ? "{\"name\":" : ",{\"name\":");
+            appendString(product.getName(), out);
+            out.append(",\"price\":");
+            out.appendMoney(product.getPrice());
+            out.append('}');
+            first = false;
+        }
+        out.append("],\"total\":");
+        out.appendMoney(cart.calculateTotal());
+        out.append("}\n");
+    }
+};
+
+// compact records, native endian:
+//   header  "INV2"
+//   record  u64 invoice id, u32 line count, per line (u32 name length, name bytes, i64 price cents), i64 total cents
+// (INV1 had a u16 name length and cut longer names short)
+class BinaryInvoiceExporter : public InvoiceExporter {
+public:
+    void begin(BulkWriter& out) const override {
+        out.append("INV2", 4);
+    }
+
+    void write(uint64_t invoiceId, const ShoppingCart& cart, BulkWriter& out) const override {
+        out.appendRaw<uint64_t>(invoiceId);
+        out.appendRaw<uint32_t>(static_cast<uint32_t>(cart.getProducts().size()));
+        for (const auto& product : cart.getProducts()) {
+            out.appendRaw<uint32_t>(static_cast<uint32_t>(product.getName().size()));
+            out.append(product.getName().data(), product.getName().size());
+            out.appendRaw<int64_t>(product.getPrice().getCents());
+        }
+        out.appendRaw<int64_t>(cart.calculateTotal().getCents());
     }
 };
 
@@ -101,7 +586,7 @@ public:
 class PaymentProcessor {
 public:
     void processPayment(const ShoppingCart& cart) const {
-        double total = cart.calculateTotal();
+        Money total = cart.calculateTotal();
         cout << "\nProcessing payment of amount: " << total << endl;
 
         // Payment gateway logic would go here
@@ -109,6 +594,359 @@ public:
 };
 
 
+/*
+    =========================
+    Payment gateway types
+    Every request carries an idempotency key: the gateway remembers the
+    outcome per key, so sending the same key again (a retry after a
+    timeout or a transient failure) never charges twice.
+    =========================
+*/
+enum class PaymentStatus { Approved, Declined, Failed, TimedOut };
+
+struct PaymentRequest {
+    string idempotencyKey;
+    Money amount;
+};
+
+struct PaymentResult {
+    string idempotencyKey;
+    PaymentStatus status;
+    chrono::microseconds latency;
+};
+
+class PaymentGateway {
+public:
+    // one round trip for the whole batch, statuses come back in request order
+    virtual vector<PaymentStatus> chargeBatch(const vector<PaymentRequest>& requests) = 0;
+    virtual ~PaymentGateway() = default;
+};
+
+
+/*
+    =========================
+    SimulatedGateway Class
+    Responsibility:
+    - In-process stand-in for a payment gateway with configurable
+      round trip latency, transient failures and declines
+    - Reason to change: gateway behaviour we want to simulate changes
+    =========================
+*/
+class SimulatedGateway : public PaymentGateway {
+private:
+    chrono::microseconds baseLatency;
+    chrono::microseconds perRequestLatency;
+    double failureRate;  // transient, nothing recorded, safe to retry
+    double declineRate;
+
+    mutex lock;
+    mt19937 random{42};
+    unordered_map<string, PaymentStatus> outcomes;  // idempotency key -> final status
+    size_t roundTrips = 0;
+
+public:
+    SimulatedGateway(chrono::microseconds baseLatency, chrono::microseconds perRequestLatency,
+                     double failureRate, double declineRate)
+        : baseLatency(baseLatency), perRequestLatency(perRequestLatency),
+          failureRate(failureRate), declineRate(declineRate) {}
+
+    vector<PaymentStatus> chargeBatch(const vector<PaymentRequest>& requests) override {
+        vector<PaymentStatus> statuses;
+        statuses.reserve(requests.size());
+        chrono::microseconds jitter;
+        {
+            lock_guard<mutex> guard(lock);
+            roundTrips++;
+            uniform_real_distribution<double> roll(0.0, 1.0);
+            jitter = chrono::microseconds(static_cast<int64_t>(roll(random) * baseLatency.count()));
+            for (const auto& request : requests) {
+                auto known = outcomes.find(request.idempotencyKey);
+                if (known != outcomes.end()) {
+                    statuses.push_back(known->second);
+                    continue;
+                }
+                double r = roll(random);
+                if (r < failureRate) {
+                    statuses.push_back(PaymentStatus::Failed);
+                    continue;
+                }
+                PaymentStatus status = r < failureRate + declineRate ? PaymentStatus::Declined : PaymentStatus::Approved;
+                outcomes.emplace(request.idempotencyKey, status);
+                statuses.push_back(status);
+            }
+        }
+        this_thread::sleep_for(baseLatency + jitter + perRequestLatency * static_cast<int64_t>(requests.size()));
+        return statuses;
+    }
+
+    size_t getRoundTrips() {
+        lock_guard<mutex> guard(lock);
+        return roundTrips;
+    }
+};
+
+
+/*
+    =========================
+    AsyncPaymentProcessor Class
+    Responsibility:
+    - Accept payments without blocking on the gateway
+    - Bounded queue (submit blocks when full), micro-batching,
+      per-request deadlines, retries of transient failures
+    - Reason to change: payment dispatch policy changes
+    A deadline sweeper completes a request with TimedOut as soon as its
+    deadline passes, whether it is still queued or its gateway call is in
+    flight; a gateway answer that arrives later is ignored (a retry with the
+    same key learns the real outcome from the gateway).
+    The same idempotency key submitted twice while the first one is
+    pending, or after it succeeded/was declined, gets the same result.
+    Settled outcomes are only kept for settledTtl and at most
+    settledCapacity keys (oldest first out); a key resubmitted after that
+    is sent to the gateway again, whose own idempotency check answers it.
+    =========================
+*/
+class AsyncPaymentProcessor {
+private:
+    // completion state shared by the queue / worker and the deadline sweeper, whoever finishes first wins
+    struct PaymentTicket {
+        string idempotencyKey;
+        chrono::steady_clock::time_point submitted;
+        chrono::steady_clock::time_point deadline;
+        atomic<bool> completed{false};
+        promise<PaymentResult> result;
+    };
+
+    struct PendingPayment {
+        PaymentRequest request;
+        shared_ptr<PaymentTicket> ticket;
+    };
+
+    using Deadline = pair<chrono::steady_clock::time_point, shared_ptr<PaymentTicket>>;
+    struct LaterDeadline {
+        bool operator()(const Deadline& a, const Deadline& b) const { return a.first > b.first; }
+    };
+
+    PaymentGateway& gateway;
+    size_t capacity;
+    size_t maxBatch;
+    chrono::microseconds batchWindow;
+    int maxAttempts;
+    size_t settledCapacity;
+    chrono::steady_clock::duration settledTtl;
+
+    mutex lock;
+    condition_variable notEmpty;
+    condition_variable notFull;
+    deque<PendingPayment> queue;
+    unordered_map<string, shared_future<PaymentResult>> known;
+    deque<pair<chrono::steady_clock::time_point, string>> settled;  // keys in known with a final outcome, oldest first
+    bool stopping = false;
+    vector<thread> workers;
+
+    mutex sweepLock;
+    condition_variable sweepWake;
+    priority_queue<Deadline, vector<Deadline>, LaterDeadline> deadlines;  // earliest first
+    bool sweeperStopping = false;
+    thread sweeper;
+
+    // completes the request unless it already was (timed out by the sweeper, or answered by the gateway)
+    void finish(PaymentTicket& ticket, PaymentStatus status) {
+        if (ticket.completed.exchange(true)) {
+            return;
+        }
+        auto now = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> guard(lock);
+            // only final outcomes are remembered, a timed out or failed key may be submitted again
+            if (status == PaymentStatus::Failed || status == PaymentStatus::TimedOut) {
+                known.erase(ticket.idempotencyKey);
+            } else {
+                settled.emplace_back(now, ticket.idempotencyKey);
+            }
+            while (!settled.empty() && (settled.size() > settledCapacity || now - settled.front().first > settledTtl)) {
+                known.erase(settled.front().second);
+                settled.pop_front();
+            }
+        }
+        ticket.result.set_value({ticket.idempotencyKey, status,
+                                 chrono::duration_cast<chrono::microseconds>(now - ticket.submitted)});
+    }
+
+    // times requests out at their deadline, independent of the queue and the gateway
+    void sweepLoop() {
+        unique_lock<mutex> guard(sweepLock);
+        while (!sweeperStopping) {
+            if (deadlines.empty()) {
+                sweepWake.wait(guard);
+                continue;
+            }
+            if (deadlines.top().first > chrono::steady_clock::now()) {
+                sweepWake.wait_until(guard, deadlines.top().first);
+                continue;
+            }
+            shared_ptr<PaymentTicket> ticket = deadlines.top().second;
+            deadlines.pop();
+            if (!ticket->completed.load()) {
+                guard.unlock();
+                finish(*ticket, PaymentStatus::TimedOut);
+                guard.lock();
+            }
+        }
+    }
+
+    // waits for the first request, then up to batchWindow for the batch to fill
+    bool takeBatch(vector<PendingPayment>& batch) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return false;
+        }
+        auto windowEnd = chrono::steady_clock::now() + batchWindow;
+        notEmpty.wait_until(guard, windowEnd, [&] { return stopping || queue.size() >= maxBatch; });
+
+        while (!queue.empty() && batch.size() < maxBatch) {
+            batch.push_back(move(queue.front()));
+            queue.pop_front();
+        }
+        notFull.notify_all();
+        return true;
+    }
+
+    void dispatch(vector<PendingPayment>& batch) {
+        for (int attempt = 0; attempt < maxAttempts && !batch.empty(); attempt++) {
+            vector<PendingPayment> live;
+            auto now = chrono::steady_clock::now();
+            for (auto& pending : batch) {
+                if (pending.ticket->completed.load()) {
+                    continue;  // already timed out by the sweeper
+                }
+                if (now >= pending.ticket->deadline) {
+                    finish(*pending.ticket, PaymentStatus::TimedOut);
+                } else {
+                    live.push_back(move(pending));
+                }
+            }
+            if (live.empty()) {
+                return;
+            }
+
+            vector<PaymentRequest> requests;
+            requests.reserve(live.size());
+            for (const auto& pending : live) {
+                requests.push_back(pending.request);
+            }
+            vector<PaymentStatus> statuses = gateway.chargeBatch(requests);
+
+            batch.clear();
+            now = chrono::steady_clock::now();
+            for (size_t i = 0; i < live.size(); i++) {
+                if (statuses[i] == PaymentStatus::Failed && attempt + 1 < maxAttempts) {
+                    batch.push_back(move(live[i]));  // retried with the same key
+                } else if (now >= live[i].ticket->deadline) {
+                    // the gateway may have charged, a retry with this key will tell
+                    finish(*live[i].ticket, PaymentStatus::TimedOut);
+                } else {
+                    finish(*live[i].ticket, statuses[i]);
+                }
+            }
+        }
+        for (auto& pending : batch) {
+            finish(*pending.ticket, PaymentStatus::Failed);
+        }
+    }
+
+    void workerLoop() {
+        vector<PendingPayment> batch;
+        while (true) {
+            batch.clear();
+            if (!takeBatch(batch)) {
+                return;
+            }
+            dispatch(batch);
+        }
+    }
+
+public:
+    AsyncPaymentProcessor(PaymentGateway& gateway, size_t workerCount = 4, size_t capacity = 4096,
+                          size_t maxBatch = 64, chrono::microseconds batchWindow = chrono::microseconds(500),
+                          int maxAttempts = 3, size_t settledCapacity = 1 << 16,
+                          chrono::seconds settledTtl = chrono::seconds(600))
+        : gateway(gateway), capacity(capacity), maxBatch(maxBatch), batchWindow(batchWindow), maxAttempts(maxAttempts),
+          settledCapacity(settledCapacity), settledTtl(settledTtl) {
+        for (size_t i = 0; i < workerCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+        sweeper = thread([this] { sweepLoop(); });
+    }
+
+    // drains whatever is still queued before returning
+    ~AsyncPaymentProcessor() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        // every request is completed once the workers are done, the sweeper has nothing left to time out
+        {
+            lock_guard<mutex> guard(sweepLock);
+            sweeperStopping = true;
+        }
+        sweepWake.notify_all();
+        sweeper.join();
+    }
+
+    shared_future<PaymentResult> submit(const PaymentRequest& request, chrono::milliseconds timeout) {
+        unique_lock<mutex> guard(lock);
+        // the key is checked after waiting for room: another submit with the same key
+        // may have been queued while this one was blocked on a full queue
+        notFull.wait(guard, [&] {
+            return stopping || queue.size() < capacity || known.count(request.idempotencyKey) > 0;
+        });
+        auto existing = known.find(request.idempotencyKey);
+        if (existing != known.end()) {
+            return existing->second;
+        }
+
+        auto now = chrono::steady_clock::now();
+        auto ticket = make_shared<PaymentTicket>();
+        ticket->idempotencyKey = request.idempotencyKey;
+        ticket->submitted = now;
+        ticket->deadline = now + timeout;
+        shared_future<PaymentResult> result = ticket->result.get_future().share();
+        if (stopping) {
+            ticket->result.set_value({request.idempotencyKey, PaymentStatus::Failed, chrono::microseconds(0)});
+            return result;
+        }
+        known.emplace(request.idempotencyKey, result);
+        queue.push_back({request, ticket});
+        bool othersMayWait = queue.size() >= capacity;
+        guard.unlock();
+        {
+            lock_guard<mutex> sweepGuard(sweepLock);
+            bool earliest = deadlines.empty() || ticket->deadline < deadlines.top().first;
+            deadlines.emplace(ticket->deadline, ticket);
+            if (earliest) {
+                sweepWake.notify_one();
+            }
+        }
+        notEmpty.notify_one();
+        if (othersMayWait) {
+            notFull.notify_all();  // a blocked submit with this key can return the new future right away
+        }
+        return result;
+    }
+
+    shared_future<PaymentResult> submit(const ShoppingCart& cart, const string& idempotencyKey,
+                                        chrono::milliseconds timeout) {
+        return submit(PaymentRequest{idempotencyKey, cart.calculateTotal()}, timeout);
+    }
+};
+
+
 /*
     =========================
     InvoicePrinter Class
@@ -120,11 +958,182 @@ public:
 class InvoicePrinter {
 public:
     void print(const string& invoiceData) const {
-        cout << invoiceData << endl;
+        cout << invoiceData << '\n';
+    }
+
+    // a whole batch of invoices formatted into one buffer goes out in a single write
+    void printBatch(const string& invoices) const {
+        cout.flush();
+        fwrite(invoices.data(), 1, invoices.size(), stdout);
+        fflush(stdout);
     }
 };
 
 
+/*
+    =========================
+    Cart total benchmark
+    - ShoppingCart (vector<Product>) vs ColumnarCart on the same lines
+    =========================
+*/
+void benchmarkCartTotals(size_t lines, int rounds) {
+    NameTable names;
+    ShoppingCart cart;
+    ColumnarCart columnar(names);
+    columnar.reserve(lines);
+
+    for (size_t i = 0; i < lines; i++) {
+        Product product("Item-" + to_string(i % 512), Money(100 + (i % 100) * 25));
+        cart.addProduct(product);
+        columnar.addProduct(product);
+    }
+
+    auto measure = [&](auto&& total) {
+        volatile int64_t sink = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            sink = sink + total().getCents();
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        return chrono::duration<double, nano>(elapsed).count() / rounds;
+    };
+
+    // full rescans, ShoppingCart walked the way calculateTotal used to
+    double rowNs = measure([&] {
+        Money total;
+        for (const auto& product : cart.getProducts()) {
+            total += product.getPrice();
+        }
+        return total;
+    });
+    double columnNs = measure([&] { return columnar.recomputeTotal(); });
+    double cachedNs = measure([&] { return columnar.calculateTotal(); });
+
+    cout << "\nCart total (" << lines << " lines): ShoppingCart scan " << rowNs
+         << " ns, ColumnarCart scan " << columnNs << " ns, running total "
+         << cachedNs << " ns"
+         << (columnar.recomputeTotal() == columnar.calculateTotal() ? "" : " (TOTAL MISMATCH)") << endl;
+}
+
+
+/*
+    =========================
+    Invoice formatting benchmark
+    - string + / to_string per line vs InvoiceFormatter into a reused buffer
+    =========================
+*/
+void benchmarkInvoiceFormatting(const ShoppingCart& cart, int invoices) {
+    InvoiceGenerator generator;
+    InvoiceFormatter formatter;
+
+    auto start = chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (int i = 0; i < invoices; i++) {
+        bytes += generator.generate(cart).size();
+    }
+    double generateMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // end-of-day style: a batch of invoices per buffer, the buffer is reused across batches
+    string buffer;
+    const int batchSize = 1000;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < invoices; i += batchSize) {
+        buffer.clear();
+        for (int j = i; j < min(invoices, i + batchSize); j++) {
+            formatter.format(cart, buffer);
+        }
+        bytes += buffer.size();
+    }
+    double formatterMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << "Invoice formatting (" << invoices << " invoices, " << bytes << " bytes): generate "
+         << generateMs << " ms, formatter " << formatterMs << " ms" << endl;
+}
+
+
+/*
+    =========================
+    Invoice export benchmark
+    - streams the same cart as many invoices through every exporter
+    =========================
+*/
+void benchmarkInvoiceExport(const ShoppingCart& cart, uint64_t invoices) {
+    CsvInvoiceExporter csv;
+    JsonInvoiceExporter json;
+    BinaryInvoiceExporter binary;
+    const pair<const char*, const InvoiceExporter*> exporters[] = {
+        {"invoices.csv", &csv}, {"invoices.jsonl", &json}, {"invoices.bin", &binary}};
+
+    for (const auto& [path, exporter] : exporters) {
+        BulkWriter out(path);
+        if (!out.isOpen()) {
+            continue;
+        }
+        auto start = chrono::steady_clock::now();
+        exporter->begin(out);
+        for (uint64_t id = 0; id < invoices; id++) {
+            exporter->write(id, cart, out);
+        }
+        exporter->end(out);
+        if (!out.flush()) {
+            cout << "Export to " << path << " failed after " << out.bytesWritten() << " bytes" << endl;
+            continue;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Exported " << invoices << " invoices to " << path << ": "
+             << out.bytesWritten() / seconds / 1e6 << " MB/s" << endl;
+    }
+}
+
+
+/*
+    =========================
+    Payment load test
+    - producers submit payments concurrently, reports throughput and latency percentiles
+    =========================
+*/
+void loadTestPayments(size_t requests, size_t producers) {
+    SimulatedGateway gateway(chrono::microseconds(2000), chrono::microseconds(10), 0.02, 0.05);
+    vector<PaymentResult> results(requests);
+
+    auto start = chrono::steady_clock::now();
+    {
+        AsyncPaymentProcessor processor(gateway, 8);
+        vector<thread> threads;
+        for (size_t p = 0; p < producers; p++) {
+            threads.emplace_back([&, p] {
+                vector<pair<size_t, shared_future<PaymentResult>>> pending;
+                for (size_t i = p; i < requests; i += producers) {
+                    pending.emplace_back(i, processor.submit(
+                        PaymentRequest{"order-" + to_string(i), Money(1000 + static_cast<int64_t>(i % 500))},
+                        chrono::milliseconds(200)));
+                }
+                for (auto& [index, result] : pending) {
+                    results[index] = result.get();
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<int64_t> latencies;
+    size_t approved = 0;
+    for (const auto& result : results) {
+        latencies.push_back(result.latency.count());
+        approved += result.status == PaymentStatus::Approved;
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1000.0; };
+
+    cout << "Payments: " << requests / seconds << " req/s, p50 " << percentile(0.50) << " ms, p99 "
+         << percentile(0.99) << " ms, approved " << approved << "/" << requests
+         << ", gateway round trips " << gateway.getRoundTrips() << endl;
+}
+
+
 /*
     =========================
     Main Function
@@ -133,8 +1142,8 @@ public:
 int main() {
 
     // Create products (no raw pointers needed)
-    Product laptop("Laptop", 1000.0);
-    Product smartphone("Smartphone", 500.0);
+    Product laptop("Laptop", Money::fromDouble(1000.0));
+    Product smartphone("Smartphone", Money::fromDouble(500.0));
 
     // Create shopping cart
     ShoppingCart cart;
@@ -153,5 +1162,11 @@ int main() {
     InvoicePrinter printer;
     printer.print(invoiceData);
 
+    // Compare cart layouts on a large cart
+    benchmarkCartTotals(4096, 2000);
+    benchmarkInvoiceFormatting(cart, 100000);
+    benchmarkInvoiceExport(cart, 100000);
+    loadTestPayments(20000, 4);
+
     return 0;
 }
@@ -0,0 +1,94 @@
+#pragma once
+
+// Worker pool shared by the SOLID and design_pattern programs, include it with a relative path.
+
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+
+// fixed set of worker threads started once and reused by every run() call.
+// run() splits [0, count) into chunks that workers pull from a shared counter, so an idle worker simply
+// takes the next chunk and one slow chunk never stalls the rest; the calling thread works along.
+class WorkerPool{
+    private:
+        std::vector<std::thread> workers;
+        std::mutex runLock; // one run() at a time
+        std::mutex lock;
+        std::condition_variable wake, done;
+        const std::function<void(size_t, size_t)>* body = nullptr;
+        size_t count = 0, chunk = 1;
+        std::atomic<size_t> next{0};
+        size_t generation = 0;
+        size_t active = 0; // workers still inside the current run
+        bool stopping = false;
+
+        void drain(){
+            for (size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk)) {
+                (*body)(begin, std::min(count, begin + chunk));
+            }
+        }
+
+        void workerLoop(){
+            size_t seen = 0;
+            std::unique_lock<std::mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [&](){ return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                guard.unlock();
+                drain();
+                guard.lock();
+                if (--active == 0) {
+                    done.notify_all();
+                }
+            }
+        }
+
+    public:
+        explicit WorkerPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())){
+            for (unsigned t = 1; t < threads; t++) {
+                workers.emplace_back(&WorkerPool::workerLoop, this);
+            }
+        }
+
+        ~WorkerPool(){
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // the workers plus the calling thread
+        size_t threads() const { return workers.size() + 1; }
+
+        void run(size_t n, size_t chunkSize, const std::function<void(size_t, size_t)>& fn){
+            std::lock_guard<std::mutex> serial(runLock);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                body = &fn;
+                count = n;
+                chunk = std::max<size_t>(1, chunkSize);
+                next = 0;
+                active = workers.size();
+                generation++;
+            }
+            wake.notify_all();
+            drain();
+            std::unique_lock<std::mutex> guard(lock);
+            done.wait(guard, [&](){ return active == 0; });
+        }
+};
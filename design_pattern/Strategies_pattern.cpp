@@ -1,14 +1,28 @@
 #include<iostream>
 #include<bits/stdc++.h>
+#ifdef __linux__
+#include<pthread.h>
+#include<sched.h>
+#endif
+#include "../common/WorkerPool.h"
 using namespace std;
 
 
 // Strategy Pattern is a behavioral design pattern that enables selecting an algorithm's behavior at runtime.
 
+// state a simulated robot carries from one tick to the next
+struct RobotState{
+    float distance = 0;
+    float altitude = 0;
+    uint32_t wordsSpoken = 0;
+};
+
 //  abstarct class 
 class Talkable{
     public:
         virtual void talk()= 0;
+        // simulation parameter, how many words the robot says per tick
+        virtual uint32_t wordsPerTick() const = 0;
         virtual ~Talkable() = default;
 };
 
@@ -18,6 +32,10 @@ class EnglishTalkable: public Talkable{
         void talk() override{
             cout<<"Hello, I am a robot that can talk in English."<<endl;
         }
+
+        uint32_t wordsPerTick() const override{
+            return 3;
+        }
 };
 
 class HindiTalkable: public Talkable{
@@ -25,12 +43,18 @@ class HindiTalkable: public Talkable{
         void talk() override{
             cout<<"Me Hindi Support karta hu !"<<endl;
         }
+
+        uint32_t wordsPerTick() const override{
+            return 2;
+        }
 };
 
 // abstract class
 class Walkable{
     public:
         virtual void walk()= 0;
+        // simulation parameter, distance covered per second
+        virtual float speed() const = 0;
         virtual ~Walkable() = default;
 };
 
@@ -40,6 +64,10 @@ class FastWalkable: public Walkable{
         void walk() override{
             cout<<"I am a robot that can walk fast."<<endl;
         }
+
+        float speed() const override{
+            return 2.0f;
+        }
 };
 
 class SlowWalkable: public Walkable{
@@ -47,12 +75,18 @@ class SlowWalkable: public Walkable{
         void walk() override{
             cout<<"I am a robot that can walk slow."<<endl;
         }
+
+        float speed() const override{
+            return 0.5f;
+        }
 };
 
 // abstract class
 class Flyable{
     public:
         virtual void fly()= 0;
+        // simulation parameter, altitude gained per second
+        virtual float climbRate() const = 0;
         virtual ~Flyable() = default;
 };
 
@@ -62,6 +96,10 @@ class CanFlyable: public Flyable{
         void fly() override{
             cout<<"I am a robot that can fly."<<endl;
         }
+
+        float climbRate() const override{
+            return 1.0f;
+        }
 };
 
 class CannotFlyable: public Flyable{
@@ -69,6 +107,10 @@ class CannotFlyable: public Flyable{
         void fly() override{
             cout<<"I am a robot that cannot fly."<<endl;
         }
+
+        float climbRate() const override{
+            return 0.0f;
+        }
 };
 
 //  Robot class that has a relationship with the above abstract classes
@@ -83,18 +125,25 @@ class Robot{
     public:
         Robot(Talkable* talkable, Walkable* walkable, Flyable* flyable): talkable(talkable), walkable(walkable), flyable(flyable){}
 
-        void talk(){
+        virtual void talk(){
             talkable->talk();
         }
 
-        void walk(){
+        virtual void walk(){
             walkable->walk();
         }
 
-        void fly(){
+        virtual void fly(){
             flyable->fly();
         }
 
+        // one simulation tick, three virtual calls per robot
+        virtual void simulate(RobotState& state, float dt){
+            state.wordsSpoken += talkable->wordsPerTick();
+            state.distance += walkable->speed() * dt;
+            state.altitude += flyable->climbRate() * dt;
+        }
+
         virtual void projetion()= 0;
         virtual ~Robot() = default;
 };
@@ -109,6 +158,852 @@ class HumanoidRobot: public Robot{
 };
 
 
+// Data oriented fleet: robots that share the same strategy combination live in one group,
+// and a group keeps its robots' state in parallel arrays. A tick asks each strategy for its
+// parameters once per group and then runs a plain loop over the arrays, no virtual call per robot.
+class RobotFleet{
+    private:
+        struct Group{
+            Talkable* talkable;
+            Walkable* walkable;
+            Flyable* flyable;
+            vector<float> distance;
+            vector<float> altitude;
+            vector<uint32_t> wordsSpoken;
+        };
+
+        vector<Group> groups;
+        WorkerPool pool;
+        static constexpr size_t CHUNK = 16384;
+
+        static void tickRange(Group& group, size_t begin, size_t end, float dt){
+            const uint32_t words = group.talkable->wordsPerTick();
+            const float step = group.walkable->speed() * dt;
+            const float climb = group.flyable->climbRate() * dt;
+            float* distance = group.distance.data();
+            float* altitude = group.altitude.data();
+            uint32_t* spoken = group.wordsSpoken.data();
+            for (size_t i = begin; i < end; i++) {
+                distance[i] += step;
+                altitude[i] += climb;
+                spoken[i] += words;
+            }
+        }
+
+    public:
+        struct Handle{
+            size_t group;
+            size_t index;
+        };
+
+        explicit RobotFleet(unsigned threads = max(1u, thread::hardware_concurrency())) : pool(threads) {}
+
+        Handle addRobot(Talkable* talkable, Walkable* walkable, Flyable* flyable){
+            size_t g = 0;
+            while (g < groups.size() && !(groups[g].talkable == talkable && groups[g].walkable == walkable && groups[g].flyable == flyable)) {
+                g++;
+            }
+            if (g == groups.size()) {
+                groups.push_back({talkable, walkable, flyable, {}, {}, {}});
+            }
+            groups[g].distance.push_back(0);
+            groups[g].altitude.push_back(0);
+            groups[g].wordsSpoken.push_back(0);
+            return {g, groups[g].distance.size() - 1};
+        }
+
+        RobotState state(Handle handle) const {
+            const Group& group = groups[handle.group];
+            return {group.distance[handle.index], group.altitude[handle.index], group.wordsSpoken[handle.index]};
+        }
+
+        size_t size() const {
+            size_t count = 0;
+            for (const auto& group : groups) {
+                count += group.distance.size();
+            }
+            return count;
+        }
+
+        // groups are cut into chunks that the pool's threads pull from a shared counter
+        void tick(float dt){
+            vector<tuple<size_t, size_t, size_t>> chunks;
+            for (size_t g = 0; g < groups.size(); g++) {
+                for (size_t begin = 0; begin < groups[g].distance.size(); begin += CHUNK) {
+                    chunks.emplace_back(g, begin, min(groups[g].distance.size(), begin + CHUNK));
+                }
+            }
+
+            pool.run(chunks.size(), 1, [&](size_t first, size_t last){
+                for (size_t c = first; c < last; c++) {
+                    auto [g, begin, end] = chunks[c];
+                    tickRange(groups[g], begin, end, dt);
+                }
+            });
+        }
+};
+
+
+// ticks per second of the pointer-per-robot model vs the grouped fleet on the same robots
+void benchmarkFleet(size_t robots, int ticks){
+    EnglishTalkable english;
+    HindiTalkable hindi;
+    FastWalkable fast;
+    SlowWalkable slow;
+    CanFlyable canFly;
+    CannotFlyable cannotFly;
+    Talkable* talkers[] = {&english, &hindi};
+    Walkable* walkers[] = {&fast, &slow};
+    Flyable* flyers[] = {&canFly, &cannotFly};
+
+    vector<unique_ptr<Robot>> objects;
+    vector<RobotState> states(robots);
+    RobotFleet fleet;
+    mt19937 random(3);
+    for (size_t i = 0; i < robots; i++) {
+        Talkable* t = talkers[random() % 2];
+        Walkable* w = walkers[random() % 2];
+        Flyable* f = flyers[random() % 2];
+        objects.push_back(make_unique<HumanoidRobot>(t, w, f));
+        fleet.addRobot(t, w, f);
+    }
+
+    const float dt = 0.016f;
+    auto start = chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (size_t i = 0; i < robots; i++) {
+            objects[i]->simulate(states[i], dt);
+        }
+    }
+    double objectSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        fleet.tick(dt);
+    }
+    double fleetSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Fleet of " << robots << " robots: pointer-per-robot " << ticks / objectSeconds
+         << " ticks/s, grouped fleet " << ticks / fleetSeconds << " ticks/s" << endl;
+}
+
+
+// Compile time composition: when the strategy combination is known at build time the strategies become
+// template parameters, held by value. Calls are qualified with the policy type (talkable.TalkPolicy::talk()),
+// which is a static call the compiler can inline, so no vtable is involved.
+// Any class with the matching member functions works as a policy, including the strategies above.
+template<typename TalkPolicy, typename WalkPolicy, typename FlyPolicy>
+class PolicyRobot{
+    private:
+        TalkPolicy talkable;
+        WalkPolicy walkable;
+        FlyPolicy flyable;
+
+    public:
+        void talk(){
+            talkable.TalkPolicy::talk();
+        }
+
+        void walk(){
+            walkable.WalkPolicy::walk();
+        }
+
+        void fly(){
+            flyable.FlyPolicy::fly();
+        }
+
+        void simulate(RobotState& state, float dt){
+            state.wordsSpoken += talkable.TalkPolicy::wordsPerTick();
+            state.distance += walkable.WalkPolicy::speed() * dt;
+            state.altitude += flyable.FlyPolicy::climbRate() * dt;
+        }
+
+        TalkPolicy& talkPolicy() { return talkable; }
+        WalkPolicy& walkPolicy() { return walkable; }
+        FlyPolicy& flyPolicy() { return flyable; }
+};
+
+// holds the PolicyRobot so it is constructed before the Robot base that points into it
+template<typename TalkPolicy, typename WalkPolicy, typename FlyPolicy>
+class PolicyRobotHolder{
+    protected:
+        PolicyRobot<TalkPolicy, WalkPolicy, FlyPolicy> policyRobot;
+};
+
+// Adapter: a PolicyRobot usable wherever a runtime Robot is expected (e.g. in a vector<Robot*>).
+// Calls through the Robot interface are virtual again, calls through policy() stay static.
+template<typename TalkPolicy, typename WalkPolicy, typename FlyPolicy>
+class PolicyRobotAdapter: private PolicyRobotHolder<TalkPolicy, WalkPolicy, FlyPolicy>, public Robot{
+    public:
+        PolicyRobotAdapter()
+            : Robot(&this->policyRobot.talkPolicy(), &this->policyRobot.walkPolicy(), &this->policyRobot.flyPolicy()){}
+
+        void projetion() override{
+            cout<<"I am a robot composed at compile time."<<endl;
+        }
+
+        PolicyRobot<TalkPolicy, WalkPolicy, FlyPolicy>& policy(){
+            return this->policyRobot;
+        }
+};
+
+
+// cost of one simulation step through the vtable vs through the policy robot, same strategy combination
+void benchmarkPolicyDispatch(size_t robots, int ticks){
+    using Composed = PolicyRobot<HindiTalkable, FastWalkable, CanFlyable>;
+    HindiTalkable hindi;
+    FastWalkable fast;
+    CanFlyable canFly;
+
+    vector<unique_ptr<Robot>> runtimeRobots;
+    vector<Composed> composedRobots(robots);
+    for (size_t i = 0; i < robots; i++) {
+        runtimeRobots.push_back(make_unique<HumanoidRobot>(&hindi, &fast, &canFly));
+    }
+    vector<RobotState> runtimeStates(robots), composedStates(robots);
+
+    const float dt = 0.016f;
+    auto start = chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (size_t i = 0; i < robots; i++) {
+            runtimeRobots[i]->simulate(runtimeStates[i], dt);
+        }
+    }
+    double runtimeNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (double(robots) * ticks);
+
+    start = chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (size_t i = 0; i < robots; i++) {
+            composedRobots[i].simulate(composedStates[i], dt);
+        }
+    }
+    double composedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (double(robots) * ticks);
+
+    cout << "Dispatch per robot step: runtime Robot " << runtimeNs << " ns, PolicyRobot " << composedNs << " ns" << endl;
+}
+
+
+// ---------------------------------------------------------------------------
+// Hot swappable strategies.
+// A control thread can replace a robot's strategy while worker threads are calling it.
+// Publication is RCU style: readers mark themselves "inside a read section" in their own slot, read the
+// current pointer and call it, with no lock and no reference count on the call path. A writer swaps the
+// pointer in, then waits until every reader that might still hold the old pointer has left its read
+// section, and only then deletes the old strategy.
+// Reader threads beyond the fixed slot table are not refused: they share two overflow counters instead,
+// which is slower under contention but just as safe.
+// ---------------------------------------------------------------------------
+
+class RcuDomain{
+    private:
+        struct alignas(64) ReaderSlot{
+            atomic<uint64_t> epoch{0}; // 0 = not inside a read section
+            atomic<bool> used{false};
+        };
+
+        static constexpr size_t MAX_READERS = 256;
+        array<ReaderSlot, MAX_READERS> readers;
+        atomic<uint64_t> globalEpoch{1};
+
+        // readers without a slot count themselves in overflowReaders[phase]; a writer flips the phase,
+        // so new readers go to the other counter, and waits for the old one to drain
+        alignas(64) array<atomic<uint64_t>, 2> overflowReaders{};
+        atomic<size_t> overflowPhase{0};
+        mutex overflowLock; // one phase flip at a time
+
+    public:
+        static constexpr size_t OVERFLOW_SLOT = MAX_READERS;
+
+        static RcuDomain& global(){
+            static RcuDomain domain;
+            return domain;
+        }
+
+        // OVERFLOW_SLOT when every slot is taken
+        size_t claimSlot(){
+            for (size_t slot = 0; slot < MAX_READERS; slot++) {
+                if (!readers[slot].used.load(memory_order_relaxed) && !readers[slot].used.exchange(true)) {
+                    return slot;
+                }
+            }
+            return OVERFLOW_SLOT;
+        }
+
+        void releaseSlot(size_t slot){
+            if (slot == OVERFLOW_SLOT) {
+                return;
+            }
+            readers[slot].epoch.store(0);
+            readers[slot].used.store(false);
+        }
+
+        // seq_cst store, then the caller loads the pointer: a writer that swapped before this store
+        // is seen by the load, a writer that swaps after it sees this slot as busy.
+        // Returns the overflow phase the matching exit() needs.
+        size_t enter(size_t slot){
+            if (slot == OVERFLOW_SLOT) {
+                size_t phase = overflowPhase.load();
+                overflowReaders[phase].fetch_add(1);
+                return phase;
+            }
+            readers[slot].epoch.store(globalEpoch.load());
+            return 0;
+        }
+
+        void exit(size_t slot, size_t phase){
+            if (slot == OVERFLOW_SLOT) {
+                overflowReaders[phase].fetch_sub(1, memory_order_release);
+                return;
+            }
+            readers[slot].epoch.store(0, memory_order_release);
+        }
+
+        // waits until every read section that started before this call has finished
+        void synchronize(){
+            uint64_t target = globalEpoch.fetch_add(1) + 1;
+            for (auto& reader : readers) {
+                while (true) {
+                    uint64_t epoch = reader.epoch.load();
+                    if (epoch == 0 || epoch >= target) {
+                        break;
+                    }
+                    this_thread::yield();
+                }
+            }
+
+            lock_guard<mutex> guard(overflowLock);
+            size_t old = overflowPhase.load();
+            overflowPhase.store(old ^ 1);
+            while (overflowReaders[old].load() != 0) {
+                this_thread::yield();
+            }
+        }
+};
+
+// read section for the calling thread, nests; the thread's slot is returned when the thread exits
+class RcuReadGuard{
+    private:
+        struct ThreadSlot{
+            size_t slot = RcuDomain::global().claimSlot();
+            size_t depth = 0;
+            size_t phase = 0;
+            ~ThreadSlot(){ RcuDomain::global().releaseSlot(slot); }
+        };
+
+        static ThreadSlot& threadSlot(){
+            thread_local ThreadSlot slot;
+            return slot;
+        }
+
+    public:
+        RcuReadGuard(){
+            ThreadSlot& self = threadSlot();
+            if (self.depth++ == 0) {
+                self.phase = RcuDomain::global().enter(self.slot);
+            }
+        }
+
+        ~RcuReadGuard(){
+            ThreadSlot& self = threadSlot();
+            if (--self.depth == 0) {
+                RcuDomain::global().exit(self.slot, self.phase);
+            }
+        }
+
+        RcuReadGuard(const RcuReadGuard&) = delete;
+        RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+};
+
+// an owned pointer that can be replaced while others read it
+template<typename T>
+class RcuCell{
+    private:
+        atomic<T*> current;
+
+    public:
+        explicit RcuCell(unique_ptr<T> initial) : current(initial.release()) {}
+
+        ~RcuCell(){
+            delete current.load();
+        }
+
+        // only valid inside an RcuReadGuard
+        T* read() const {
+            return current.load();
+        }
+
+        void publish(unique_ptr<T> next){
+            T* old = current.exchange(next.release());
+            RcuDomain::global().synchronize();
+            delete old;
+        }
+};
+
+// a robot of kind Kind (e.g. HumanoidRobot) whose strategies may be swapped while other threads call it,
+// usable anywhere a Robot is (RobotCommandScheduler, vectors of Robot). It owns its strategies and
+// overrides every behaviour, so the strategy pointers Kind itself holds stay null and are never used.
+template<typename Kind>
+class SwappableRobot: public Kind{
+    private:
+        RcuCell<Talkable> talkable;
+        RcuCell<Walkable> walkable;
+        RcuCell<Flyable> flyable;
+
+    public:
+        SwappableRobot(unique_ptr<Talkable> talkable, unique_ptr<Walkable> walkable, unique_ptr<Flyable> flyable)
+            : Kind(nullptr, nullptr, nullptr), talkable(move(talkable)), walkable(move(walkable)), flyable(move(flyable)){}
+
+        void talk() override{
+            RcuReadGuard guard;
+            talkable.read()->talk();
+        }
+
+        void walk() override{
+            RcuReadGuard guard;
+            walkable.read()->walk();
+        }
+
+        void fly() override{
+            RcuReadGuard guard;
+            flyable.read()->fly();
+        }
+
+        void simulate(RobotState& state, float dt) override{
+            RcuReadGuard guard;
+            state.wordsSpoken += talkable.read()->wordsPerTick();
+            state.distance += walkable.read()->speed() * dt;
+            state.altitude += flyable.read()->climbRate() * dt;
+        }
+
+        // return once the old strategy is no longer in use and has been deleted
+        void setTalkable(unique_ptr<Talkable> next) { talkable.publish(move(next)); }
+        void setWalkable(unique_ptr<Walkable> next) { walkable.publish(move(next)); }
+        void setFlyable(unique_ptr<Flyable> next) { flyable.publish(move(next)); }
+};
+
+
+// walking strategy that checks itself on every call: a freed or half built strategy fails the check
+class CheckedWalkable: public Walkable{
+    private:
+        static constexpr uint64_t ALIVE = 0xA11CEA11CEA11CEull;
+        static constexpr uint64_t DEAD = 0xDEADDEADDEADDEADull;
+        volatile uint64_t canary;
+        uint64_t value;
+        uint64_t valueCopy;
+        atomic<uint64_t>& failures;
+
+    public:
+        CheckedWalkable(uint64_t value, atomic<uint64_t>& failures)
+            : canary(ALIVE), value(value), valueCopy(~value), failures(failures){}
+
+        ~CheckedWalkable(){
+            canary = DEAD;
+        }
+
+        void walk() override{
+            if (canary != ALIVE || value != ~valueCopy) {
+                failures.fetch_add(1);
+            }
+        }
+
+        float speed() const override{
+            return static_cast<float>(value % 4);
+        }
+};
+
+void stressTestStrategySwap(unsigned readers, chrono::milliseconds duration){
+    atomic<uint64_t> failures{0};
+    atomic<uint64_t> calls{0};
+    atomic<bool> running{true};
+    SwappableRobot<HumanoidRobot> robot(make_unique<EnglishTalkable>(), make_unique<CheckedWalkable>(0, failures), make_unique<CannotFlyable>());
+    Robot& asRobot = robot; // readers go through the plain Robot interface
+
+    vector<thread> workers;
+    for (unsigned r = 0; r < readers; r++) {
+        workers.emplace_back([&](){
+            uint64_t local = 0;
+            while (running.load(memory_order_relaxed)) {
+                asRobot.walk();
+                local++;
+            }
+            calls += local;
+        });
+    }
+
+    uint64_t swaps = 0;
+    auto end = chrono::steady_clock::now() + duration;
+    while (chrono::steady_clock::now() < end) {
+        robot.setWalkable(make_unique<CheckedWalkable>(++swaps, failures));
+    }
+    running = false;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    cout << "Strategy swap stress: " << calls.load() << " calls, " << swaps << " swaps, "
+         << failures.load() << " torn or freed strategies seen" << endl;
+}
+
+
+// ---------------------------------------------------------------------------
+// Asynchronous robot command scheduler.
+// Producers post talk / walk / fly commands instead of calling the robot themselves. Every worker thread
+// (one per core) owns a bounded queue; a robot's commands go to the same queue, and a queue is drained by
+// one thread at a time, so a robot's commands run in the order they were queued and never overlap. Workers
+// take commands in batches, and a worker whose queue is empty steals a batch from a queue nobody is draining
+// right now. A full queue rejects the command, which is how backpressure reaches the producers.
+// ---------------------------------------------------------------------------
+
+// bounded lock-free queue (Vyukov): any number of producers and consumers
+template<typename T>
+class BoundedQueue{
+    private:
+        struct Cell{
+            atomic<size_t> sequence;
+            T data;
+        };
+
+        vector<Cell> cells;
+        size_t mask;
+        alignas(64) atomic<size_t> enqueuePos{0};
+        alignas(64) atomic<size_t> dequeuePos{0};
+
+    public:
+        // capacity is rounded up to a power of two
+        explicit BoundedQueue(size_t capacity) : cells(max<size_t>(2, 1ull << (64 - __builtin_clzll(max<size_t>(capacity, 2) - 1)))) {
+            mask = cells.size() - 1;
+            for (size_t i = 0; i < cells.size(); i++) {
+                cells[i].sequence.store(i, memory_order_relaxed);
+            }
+        }
+
+        bool tryPush(const T& value){
+            size_t pos = enqueuePos.load(memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false; // full
+                } else {
+                    pos = enqueuePos.load(memory_order_relaxed);
+                }
+            }
+            cell->data = value;
+            cell->sequence.store(pos + 1, memory_order_release);
+            return true;
+        }
+
+        bool tryPop(T& value){
+            size_t pos = dequeuePos.load(memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false; // empty
+                } else {
+                    pos = dequeuePos.load(memory_order_relaxed);
+                }
+            }
+            value = cell->data;
+            cell->sequence.store(pos + mask + 1, memory_order_release);
+            return true;
+        }
+
+        size_t sizeApprox() const {
+            size_t head = dequeuePos.load(memory_order_relaxed);
+            size_t tail = enqueuePos.load(memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+};
+
+// queueing latency (submit to dequeue) in power of two nanosecond buckets
+class LatencyHistogram{
+    private:
+        array<atomic<uint64_t>, 48> buckets{};
+
+    public:
+        void record(int64_t nanoseconds){
+            uint64_t value = static_cast<uint64_t>(max<int64_t>(1, nanoseconds));
+            size_t bucket = min<size_t>(buckets.size() - 1, 63 - __builtin_clzll(value));
+            buckets[bucket].fetch_add(1, memory_order_relaxed);
+        }
+
+        // upper bound of the bucket holding the given percentile, in nanoseconds
+        uint64_t percentile(double p) const {
+            uint64_t total = 0;
+            for (const auto& bucket : buckets) {
+                total += bucket.load(memory_order_relaxed);
+            }
+            uint64_t rank = static_cast<uint64_t>(p * total);
+            uint64_t seen = 0;
+            for (size_t b = 0; b < buckets.size(); b++) {
+                seen += buckets[b].load(memory_order_relaxed);
+                if (seen > rank) {
+                    return 2ull << b;
+                }
+            }
+            return 0;
+        }
+};
+
+enum class RobotCommand : uint8_t { Talk, Walk, Fly };
+
+class RobotCommandScheduler{
+    private:
+        struct Envelope{
+            Robot* robot;
+            RobotCommand command;
+            int64_t enqueuedNs;
+        };
+
+        struct alignas(64) Worker{
+            BoundedQueue<Envelope> queue;
+            LatencyHistogram latency; // time spent queued, by queue the command was posted to, even when stolen
+            atomic<uint64_t> executed{0};
+            atomic<uint64_t> stolen{0};
+            atomic<uint64_t> rejected{0};
+            atomic<bool> draining{false}; // held by the one thread popping and running this queue's batch
+
+            explicit Worker(size_t capacity) : queue(capacity) {}
+        };
+
+        vector<unique_ptr<Worker>> workers;
+        vector<thread> threads;
+        vector<int> cpus; // the CPUs this process may run on, workers are pinned round robin over them
+        size_t batchSize;
+        atomic<bool> stopping{false};
+        atomic<uint64_t> submitted{0};
+        atomic<uint64_t> completed{0};
+
+        static int64_t nowNs(){
+            return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static void execute(const Envelope& envelope){
+            switch (envelope.command) {
+                case RobotCommand::Talk: envelope.robot->talk(); break;
+                case RobotCommand::Walk: envelope.robot->walk(); break;
+                case RobotCommand::Fly: envelope.robot->fly(); break;
+            }
+        }
+
+        // takes up to batchSize commands from one queue and runs them, returns how many ran.
+        // Returns 0 without touching the queue while another thread drains it, that thread's batch may hold
+        // earlier commands for the same robots.
+        size_t runBatch(size_t queueIndex, bool stealing){
+            Worker& source = *workers[queueIndex];
+            if (source.draining.load(memory_order_relaxed) || source.draining.exchange(true, memory_order_acquire)) {
+                return 0;
+            }
+            Envelope batch[256];
+            size_t count = 0;
+            size_t limit = stealing ? max<size_t>(1, batchSize / 2) : batchSize;
+            while (count < limit && source.queue.tryPop(batch[count])) {
+                count++;
+            }
+            // measured at dequeue, so the time the rest of the batch takes to execute is not counted as queueing
+            int64_t dequeuedNs = nowNs();
+            for (size_t i = 0; i < count; i++) {
+                source.latency.record(dequeuedNs - batch[i].enqueuedNs);
+            }
+            for (size_t i = 0; i < count; i++) {
+                execute(batch[i]);
+            }
+            source.draining.store(false, memory_order_release);
+            if (count > 0) {
+                source.executed.fetch_add(count, memory_order_relaxed);
+                if (stealing) {
+                    source.stolen.fetch_add(count, memory_order_relaxed);
+                }
+                completed.fetch_add(count, memory_order_release);
+            }
+            return count;
+        }
+
+        void workerLoop(size_t self){
+#ifdef __linux__
+            // a worker that cannot be pinned still runs, just wherever the kernel puts it
+            if (!cpus.empty()) {
+                cpu_set_t pin;
+                CPU_ZERO(&pin);
+                CPU_SET(cpus[self % cpus.size()], &pin);
+                int error = pthread_setaffinity_np(pthread_self(), sizeof(pin), &pin);
+                if (error != 0) {
+                    cerr << "worker " << self << " not pinned to cpu " << cpus[self % cpus.size()] << ": " << strerror(error) << endl;
+                }
+            }
+#endif
+            size_t idleRounds = 0;
+            while (true) {
+                size_t ran = runBatch(self, false);
+                for (size_t offset = 1; ran == 0 && offset < workers.size(); offset++) {
+                    ran = runBatch((self + offset) % workers.size(), true);
+                }
+                if (ran > 0) {
+                    idleRounds = 0;
+                    continue;
+                }
+                if (stopping.load(memory_order_acquire)) {
+                    return;
+                }
+                // back off gradually once there is nothing to run or steal
+                if (++idleRounds < 64) {
+                    this_thread::yield();
+                } else {
+                    this_thread::sleep_for(chrono::microseconds(50));
+                }
+            }
+        }
+
+    public:
+        RobotCommandScheduler(unsigned workerCount = max(1u, thread::hardware_concurrency()), size_t queueCapacity = 1 << 16, size_t batchSize = 64)
+            : batchSize(min<size_t>(batchSize, 256)) {
+#ifdef __linux__
+            // only CPUs in our affinity mask (a container or taskset may hand us any subset)
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &allowed)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            for (unsigned w = 0; w < workerCount; w++) {
+                workers.push_back(make_unique<Worker>(queueCapacity));
+            }
+            for (unsigned w = 0; w < workerCount; w++) {
+                threads.emplace_back([this, w](){ workerLoop(w); });
+            }
+        }
+
+        // runs whatever is still queued, then stops the workers
+        ~RobotCommandScheduler(){
+            drain();
+            stopping.store(true, memory_order_release);
+            for (auto& t : threads) {
+                t.join();
+            }
+        }
+
+        // false when the robot's queue is full, the caller decides whether to retry, drop or slow down
+        bool trySubmit(Robot* robot, RobotCommand command){
+            // pointers are aligned, so the low bits are mixed in before picking the queue
+            uint64_t key = reinterpret_cast<uintptr_t>(robot) * 0x9E3779B97F4A7C15ull;
+            size_t index = (key >> 32) % workers.size();
+            if (!workers[index]->queue.tryPush({robot, command, nowNs()})) {
+                workers[index]->rejected.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+            submitted.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+
+        // blocking variant, yields while the queue is full
+        void submit(Robot* robot, RobotCommand command){
+            while (!trySubmit(robot, command)) {
+                this_thread::yield();
+            }
+        }
+
+        // waits until every accepted command has run
+        void drain(){
+            while (completed.load(memory_order_acquire) < submitted.load(memory_order_relaxed)) {
+                this_thread::yield();
+            }
+        }
+
+        void printMetrics() const {
+            for (size_t w = 0; w < workers.size(); w++) {
+                const Worker& worker = *workers[w];
+                cout << "  queue " << w << ": executed " << worker.executed.load() << ", stolen " << worker.stolen.load()
+                     << ", rejected " << worker.rejected.load() << ", queued p50 <= " << worker.latency.percentile(0.50) / 1000.0
+                     << " us, p99 <= " << worker.latency.percentile(0.99) / 1000.0 << " us" << endl;
+            }
+        }
+};
+
+
+// strategy for load tests: counts calls instead of printing, and calls that ran while another one was
+// still inside (each robot has its own strategy, so that is two commands for one robot overlapping)
+class CountingStrategy: public Talkable, public Walkable, public Flyable{
+    private:
+        atomic<uint64_t> calls{0};
+        atomic<uint64_t> overlaps{0};
+        atomic<int> inside{0};
+
+        void call(){
+            if (inside.fetch_add(1, memory_order_acquire) != 0) {
+                overlaps.fetch_add(1, memory_order_relaxed);
+            }
+            calls.fetch_add(1, memory_order_relaxed);
+            inside.fetch_sub(1, memory_order_release);
+        }
+
+    public:
+        void talk() override { call(); }
+        void walk() override { call(); }
+        void fly() override { call(); }
+        uint32_t wordsPerTick() const override { return 1; }
+        float speed() const override { return 1.0f; }
+        float climbRate() const override { return 0.0f; }
+        uint64_t count() const { return calls.load(); }
+        uint64_t overlapping() const { return overlaps.load(); }
+};
+
+void benchmarkCommandScheduler(unsigned producers, size_t commandsPerProducer, size_t robots){
+    vector<unique_ptr<CountingStrategy>> strategies;
+    vector<unique_ptr<Robot>> fleet;
+    for (size_t i = 0; i < robots; i++) {
+        strategies.push_back(make_unique<CountingStrategy>());
+        CountingStrategy* strategy = strategies.back().get();
+        fleet.push_back(make_unique<HumanoidRobot>(strategy, strategy, strategy));
+    }
+
+    auto start = chrono::steady_clock::now();
+    {
+        RobotCommandScheduler scheduler;
+        vector<thread> threads;
+        for (unsigned p = 0; p < producers; p++) {
+            threads.emplace_back([&, p](){
+                mt19937 random(p + 1);
+                for (size_t i = 0; i < commandsPerProducer; i++) {
+                    scheduler.submit(fleet[random() % robots].get(), static_cast<RobotCommand>(random() % 3));
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        scheduler.drain();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        uint64_t executed = 0, overlapping = 0;
+        for (const auto& strategy : strategies) {
+            executed += strategy->count();
+            overlapping += strategy->overlapping();
+        }
+        cout << "Command scheduler: " << executed / seconds << " commands/s from " << producers << " producers ("
+             << executed << " of " << producers * commandsPerProducer << " executed, " << overlapping
+             << " overlapping on one robot)" << endl;
+        scheduler.printMetrics();
+    }
+}
+
+
 int main(){
 
     HindiTalkable hindiSpeech;
@@ -122,5 +1017,17 @@ int main(){
     robot.fly();
     robot.projetion();
 
+    // same combination, composed at compile time and used through the runtime interface
+    PolicyRobotAdapter<HindiTalkable, FastWalkable, CanFlyable> composedRobot;
+    Robot* runtimeView = &composedRobot;
+    runtimeView->talk();
+    composedRobot.policy().walk();
+    runtimeView->projetion();
+
+    benchmarkFleet(1000000, 20);
+    benchmarkPolicyDispatch(1000000, 20);
+    stressTestStrategySwap(4, chrono::milliseconds(500));
+    benchmarkCommandScheduler(4, 500000, 10000);
+
     return 0;
 }
\ No newline at end of file